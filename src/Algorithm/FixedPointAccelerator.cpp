@@ -0,0 +1,317 @@
+#include "FixedPointAccelerator.h"
+
+#include <Eigen/Cholesky>
+#include <cmath>
+
+FixedPointAccelerator::FixedPointAccelerator()
+{
+	mode = PLAIN;
+	momentum = 0.3;
+	depth = 5;
+	restart();
+}
+
+void FixedPointAccelerator::setup(int _mode, double _momentum, int _depth)
+{
+	if (_mode != mode || _depth != depth)
+	{
+		reset();
+	}
+	mode = _mode;
+	momentum = _momentum;
+	depth = _depth > 0 ? _depth : 1;
+}
+
+void FixedPointAccelerator::reset()
+{
+	last_active.clear();
+	last_moves.clear();
+	last_x.clear();
+	last_f.resize(0);
+	last_g.resize(0);
+	delta_f.clear();
+	delta_g.clear();
+}
+
+void FixedPointAccelerator::restart()
+{
+	accelerated_num = 0;
+	fallback_num = 0;
+	reset();
+}
+
+void FixedPointAccelerator::save(PointIO::SkelWriter& writer) const
+{
+	int len = last_f.size();
+	int counts[6] = {mode, depth, accelerated_num, fallback_num, (int)delta_f.size(), len};
+	writer.add("accel.counts", PointIO::SKEL_I32, 1, 6, counts);
+	writer.add("accel.values", PointIO::SKEL_F64, 1, 1, &momentum);
+	writer.add("accel.active", PointIO::SKEL_I32, 1, last_active.size(), last_active.data());
+	writer.add("accel.moves", PointIO::SKEL_F64, 1, last_moves.size(), last_moves.data());
+	writer.add("accel.last_x", PointIO::SKEL_F32, 3, last_x.size(), last_x.data());
+
+	// last_f, last_g, then every delta_f and delta_g, all of length len
+	vector<double> history;
+	history.insert(history.end(), last_f.data(), last_f.data() + len);
+	history.insert(history.end(), last_g.data(), last_g.data() + last_g.size());
+	for (int i = 0; i < delta_f.size(); i++)
+	{
+		history.insert(history.end(), delta_f[i].data(), delta_f[i].data() + len);
+		history.insert(history.end(), delta_g[i].data(), delta_g[i].data() + len);
+	}
+	writer.add("accel.history", PointIO::SKEL_F64, 1, history.size(), history.data());
+}
+
+bool FixedPointAccelerator::load(const PointIO::SkelReader& reader)
+{
+	const PointIO::SkelSection* counts_s = reader.find("accel.counts", PointIO::SKEL_I32, 1);
+	const PointIO::SkelSection* values_s = reader.find("accel.values", PointIO::SKEL_F64, 1);
+	const PointIO::SkelSection* active_s = reader.find("accel.active", PointIO::SKEL_I32, 1);
+	const PointIO::SkelSection* moves_s = reader.find("accel.moves", PointIO::SKEL_F64, 1);
+	const PointIO::SkelSection* x_s = reader.find("accel.last_x", PointIO::SKEL_F32, 3);
+	const PointIO::SkelSection* history_s = reader.find("accel.history", PointIO::SKEL_F64, 1);
+	if (!counts_s || !values_s || !active_s || !moves_s || !x_s || !history_s ||
+		counts_s->count != 6 || values_s->count != 1 || moves_s->count != active_s->count)
+	{
+		return false;
+	}
+
+	const int* counts = (const int*)reader.data(*counts_s);
+	const double* values = (const double*)reader.data(*values_s);
+	int len = counts[5];
+	int entries = counts[4];
+	bool has_g = history_s->count >= 2 * len * (entries + 1);
+	if (history_s->count != (has_g ? 2 : 1) * len + 2 * len * entries)
+	{
+		return false;
+	}
+
+	reset();
+	mode = counts[0];
+	depth = counts[1];
+	accelerated_num = counts[2];
+	fallback_num = counts[3];
+	momentum = values[0];
+
+	const int* active = (const int*)reader.data(*active_s);
+	last_active.assign(active, active + active_s->count);
+	const double* moves = (const double*)reader.data(*moves_s);
+	last_moves.assign(moves, moves + moves_s->count);
+	const Point3f* x = (const Point3f*)reader.data(*x_s);
+	last_x.assign(x, x + x_s->count);
+
+	const double* history = (const double*)reader.data(*history_s);
+	last_f = Eigen::Map<const Eigen::VectorXd>(history, len);
+	history += len;
+	if (has_g)
+	{
+		last_g = Eigen::Map<const Eigen::VectorXd>(history, len);
+		history += len;
+	}
+	for (int i = 0; i < entries; i++)
+	{
+		delta_f.push_back(Eigen::Map<const Eigen::VectorXd>(history, len));
+		delta_g.push_back(Eigen::Map<const Eigen::VectorXd>(history + len, len));
+		history += 2 * len;
+	}
+	return true;
+}
+
+void FixedPointAccelerator::accelerate(const vector<int>& active, const vector<Point3f>& x, vector<Point3f>& gx)
+{
+	if (mode == PLAIN || active.empty())
+	{
+		return;
+	}
+
+	vector<double> moves(x.size());
+	for (int i = 0; i < x.size(); i++)
+	{
+		moves[i] = (gx[i] - x[i]).SquaredNorm();
+	}
+
+	// the samples that moved in the last step too, as (index now, index then);
+	// both sets are in the order of the samples
+	vector<pair<int, int> > kept;
+	for (int k = 0, j = 0; k < active.size() && j < last_active.size();)
+	{
+		if (active[k] == last_active[j])
+		{
+			kept.push_back(make_pair(k++, j++));
+		}
+		else if (active[k] < last_active[j])
+		{
+			k++;
+		}
+		else
+		{
+			j++;
+		}
+	}
+	double residual = 0, last_residual = 0;
+	for (int i = 0; i < kept.size(); i++)
+	{
+		residual += moves[kept[i].first];
+		last_residual += last_moves[kept[i].second];
+	}
+
+	// no history left or the iteration diverges: restart from the plain step
+	if (kept.empty() || residual > last_residual)
+	{
+		if (!last_active.empty())
+		{
+			fallback_num++;
+		}
+		reset();
+		last_active = active;
+		last_moves.swap(moves);
+		last_x = x;
+		if (mode == ANDERSON)
+		{
+			accelerateAnderson(x, gx);
+		}
+		return;
+	}
+
+	if (active != last_active)
+	{
+		keepHistory(kept, x, gx);
+		last_active = active;
+	}
+	last_moves.swap(moves);
+
+	if (mode == MOMENTUM)
+	{
+		accelerateMomentum(x, gx);
+	}
+	else if (mode == ANDERSON)
+	{
+		accelerateAnderson(x, gx);
+	}
+}
+
+// carries the history of the kept samples over to the current set; the
+// samples that just started to move get no momentum and zero differences, so
+// they take the plain step until they have a history of their own
+void FixedPointAccelerator::keepHistory(const vector<pair<int, int> >& kept,
+	const vector<Point3f>& x, const vector<Point3f>& gx)
+{
+	if (mode == MOMENTUM)
+	{
+		vector<Point3f> kept_x(x);
+		for (int i = 0; i < kept.size(); i++)
+		{
+			kept_x[kept[i].first] = last_x[kept[i].second];
+		}
+		last_x.swap(kept_x);
+		return;
+	}
+
+	int n = x.size() * 3;
+	Eigen::VectorXd kept_f(n), kept_g(n);
+	for (int i = 0; i < x.size(); i++)
+	{
+		for (int d = 0; d < 3; d++)
+		{
+			kept_g[3*i + d] = gx[i][d];
+			kept_f[3*i + d] = gx[i][d] - x[i][d];
+		}
+	}
+	for (int i = 0; i < kept.size(); i++)
+	{
+		kept_f.segment<3>(3 * kept[i].first) = last_f.segment<3>(3 * kept[i].second);
+		kept_g.segment<3>(3 * kept[i].first) = last_g.segment<3>(3 * kept[i].second);
+	}
+	last_f.swap(kept_f);
+	last_g.swap(kept_g);
+
+	for (int a = 0; a < delta_f.size(); a++)
+	{
+		Eigen::VectorXd kept_df = Eigen::VectorXd::Zero(n);
+		Eigen::VectorXd kept_dg = Eigen::VectorXd::Zero(n);
+		for (int i = 0; i < kept.size(); i++)
+		{
+			kept_df.segment<3>(3 * kept[i].first) = delta_f[a].segment<3>(3 * kept[i].second);
+			kept_dg.segment<3>(3 * kept[i].first) = delta_g[a].segment<3>(3 * kept[i].second);
+		}
+		delta_f[a].swap(kept_df);
+		delta_g[a].swap(kept_dg);
+	}
+}
+
+void FixedPointAccelerator::accelerateMomentum(const vector<Point3f>& x, vector<Point3f>& gx)
+{
+	for (int i = 0; i < gx.size(); i++)
+	{
+		gx[i] += (x[i] - last_x[i]) * momentum;
+	}
+	last_x = x;
+	accelerated_num++;
+}
+
+void FixedPointAccelerator::accelerateAnderson(const vector<Point3f>& x, vector<Point3f>& gx)
+{
+	int n = gx.size() * 3;
+	Eigen::VectorXd f(n), g(n);
+	for (int i = 0; i < gx.size(); i++)
+	{
+		for (int d = 0; d < 3; d++)
+		{
+			g[3*i + d] = gx[i][d];
+			f[3*i + d] = gx[i][d] - x[i][d];
+		}
+	}
+
+	if (last_f.size() == n)
+	{
+		delta_f.push_back(f - last_f);
+		delta_g.push_back(g - last_g);
+		if (delta_f.size() > depth)
+		{
+			delta_f.pop_front();
+			delta_g.pop_front();
+		}
+	}
+	last_f = f;
+	last_g = g;
+
+	int m = delta_f.size();
+	if (m == 0)
+	{
+		return;
+	}
+
+	// least squares on the normal equations, m is tiny
+	Eigen::MatrixXd normal(m, m);
+	Eigen::VectorXd rhs(m);
+	for (int a = 0; a < m; a++)
+	{
+		rhs[a] = delta_f[a].dot(f);
+		for (int b = a; b < m; b++)
+		{
+			normal(a, b) = normal(b, a) = delta_f[a].dot(delta_f[b]);
+		}
+	}
+	double regularization = 1e-10 * normal.trace() + 1e-30;
+	normal.diagonal().array() += regularization;
+
+	Eigen::VectorXd gamma = normal.ldlt().solve(rhs);
+	if (!gamma.allFinite())
+	{
+		fallback_num++;
+		delta_f.clear();
+		delta_g.clear();
+		return;
+	}
+
+	for (int a = 0; a < m; a++)
+	{
+		g -= delta_g[a] * gamma[a];
+	}
+
+	for (int i = 0; i < gx.size(); i++)
+	{
+		gx[i] = Point3f(g[3*i], g[3*i + 1], g[3*i + 2]);
+	}
+	accelerated_num++;
+}
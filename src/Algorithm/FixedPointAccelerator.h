@@ -0,0 +1,66 @@
+#pragma once
+#include "CMesh.h"
+#include "PointIO.h"
+
+#include <vector>
+#include <deque>
+#include <Eigen/Core>
+
+using namespace std;
+using namespace vcg;
+
+// Accelerates the WLOP fixed point iteration x <- g(x) (average term plus
+// weighted repulsion). The caller evaluates g(x) as usual and hands over
+// the old and new positions of the samples that moved; the accelerator
+// replaces the new positions by the extrapolated ones.
+//
+// MOMENTUM: x' = g(x) + beta * (x - x_prev)
+// ANDERSON: x' = g(x) - dG * gamma, gamma = argmin |f - dF * gamma|, f = g(x) - x
+//
+// The history only covers the samples that moved in the last step as well:
+// samples that start to move take the plain step g(x), samples that stop
+// moving (fixed to a branch, frozen) leave it. Whenever the residual
+// |g(x) - x| of the samples that kept moving grows, the history is dropped
+// and the plain step is taken.
+class FixedPointAccelerator
+{
+public:
+	enum MODE{PLAIN = 0, MOMENTUM = 1, ANDERSON = 2};
+
+	FixedPointAccelerator();
+
+	void setup(int mode, double momentum, int depth);
+	void reset();
+	void restart(); // reset and zero the counters, for a new run
+	bool isEnabled(){ return mode != PLAIN; }
+
+	void accelerate(const vector<int>& active, const vector<Point3f>& x, vector<Point3f>& gx);
+
+	int getAcceleratedNum(){ return accelerated_num; }
+	int getFallbackNum(){ return fallback_num; }
+
+	// the history as "accel.*" sections of a checkpoint
+	void save(PointIO::SkelWriter& writer) const;
+	bool load(const PointIO::SkelReader& reader);
+
+private:
+	void keepHistory(const vector<pair<int, int> >& kept, const vector<Point3f>& x, const vector<Point3f>& gx);
+	void accelerateMomentum(const vector<Point3f>& x, vector<Point3f>& gx);
+	void accelerateAnderson(const vector<Point3f>& x, vector<Point3f>& gx);
+
+private:
+	int mode;
+	double momentum;
+	int depth;
+
+	vector<int> last_active;
+	vector<double> last_moves;     // |g(x) - x|^2 of every active sample
+
+	vector<Point3f> last_x;        // momentum
+	Eigen::VectorXd last_f, last_g; // anderson
+	deque<Eigen::VectorXd> delta_f;
+	deque<Eigen::VectorXd> delta_g;
+
+	int accelerated_num;
+	int fallback_num;
+};
@@ -0,0 +1,122 @@
+#include "IterationMetrics.h"
+
+IterationMetrics::IterationMetrics()
+{
+	iteration = 0;
+	stage = 0;
+	stage_iteration = 0;
+	stage_converged = false;
+	radius = 0;
+	error = 0;
+	percentile_error = 0;
+	moving_samples = 0;
+	frozen_samples = 0;
+	fixed_samples = 0;
+	branch_samples = 0;
+	ignored_samples = 0;
+	branches = 0;
+	mean_neighbors = 0;
+	max_neighbors = 0;
+	mean_original_neighbors = 0;
+	max_original_neighbors = 0;
+	follow_seconds = 0;
+	neighbor_seconds = 0;
+	average_seconds = 0;
+	repulsion_seconds = 0;
+	move_seconds = 0;
+	grow_seconds = 0;
+	total_seconds = 0;
+}
+
+IterationMetricsWriter::IterationMetricsWriter()
+{
+	out = NULL;
+	format = CSV;
+}
+
+IterationMetricsWriter::~IterationMetricsWriter()
+{
+	close();
+}
+
+int IterationMetricsWriter::formatFromName(const std::string& name)
+{
+	if (name == "csv")
+	{
+		return CSV;
+	}
+	if (name == "jsonl")
+	{
+		return JSONL;
+	}
+	return -1;
+}
+
+bool IterationMetricsWriter::open(const std::string& filename, int _format, std::string& error)
+{
+	close();
+	out = fopen(filename.c_str(), "w");
+	if (out == NULL)
+	{
+		error = "could not open " + filename + " for writing";
+		return false;
+	}
+	format = _format;
+	if (format == CSV)
+	{
+		fprintf(out, "iteration,stage,stage_iteration,stage_converged,radius,error,"
+			"percentile_error,moving_samples,frozen_samples,fixed_samples,branch_samples,"
+			"ignored_samples,branches,mean_neighbors,max_neighbors,mean_original_neighbors,"
+			"max_original_neighbors,follow_seconds,neighbor_seconds,average_seconds,"
+			"repulsion_seconds,move_seconds,grow_seconds,total_seconds\n");
+		fflush(out);
+	}
+	return true;
+}
+
+void IterationMetricsWriter::write(const IterationMetrics& m)
+{
+	if (out == NULL)
+	{
+		return;
+	}
+	if (format == CSV)
+	{
+		fprintf(out, "%d,%d,%d,%d,%.9g,%.9g,%.9g,%d,%d,%d,%d,%d,%d,%.3f,%d,%.3f,%d,"
+			"%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+			m.iteration, m.stage, m.stage_iteration, m.stage_converged ? 1 : 0, m.radius,
+			m.error, m.percentile_error, m.moving_samples, m.frozen_samples, m.fixed_samples,
+			m.branch_samples, m.ignored_samples, m.branches, m.mean_neighbors, m.max_neighbors,
+			m.mean_original_neighbors, m.max_original_neighbors, m.follow_seconds,
+			m.neighbor_seconds, m.average_seconds, m.repulsion_seconds, m.move_seconds,
+			m.grow_seconds, m.total_seconds);
+	}
+	else
+	{
+		fprintf(out, "{\"iteration\": %d, \"stage\": %d, \"stage_iteration\": %d, "
+			"\"stage_converged\": %s, \"radius\": %.9g, \"error\": %.9g, "
+			"\"percentile_error\": %.9g, \"moving_samples\": %d, \"frozen_samples\": %d, "
+			"\"fixed_samples\": %d, \"branch_samples\": %d, \"ignored_samples\": %d, "
+			"\"branches\": %d, \"mean_neighbors\": %.3f, \"max_neighbors\": %d, "
+			"\"mean_original_neighbors\": %.3f, \"max_original_neighbors\": %d, "
+			"\"follow_seconds\": %.6f, \"neighbor_seconds\": %.6f, \"average_seconds\": %.6f, "
+			"\"repulsion_seconds\": %.6f, \"move_seconds\": %.6f, \"grow_seconds\": %.6f, "
+			"\"total_seconds\": %.6f}\n",
+			m.iteration, m.stage, m.stage_iteration, m.stage_converged ? "true" : "false",
+			m.radius, m.error, m.percentile_error, m.moving_samples, m.frozen_samples,
+			m.fixed_samples, m.branch_samples, m.ignored_samples, m.branches, m.mean_neighbors,
+			m.max_neighbors, m.mean_original_neighbors, m.max_original_neighbors,
+			m.follow_seconds, m.neighbor_seconds, m.average_seconds, m.repulsion_seconds,
+			m.move_seconds, m.grow_seconds, m.total_seconds);
+	}
+	fflush(out);
+}
+
+void IterationMetricsWriter::close()
+{
+	if (out != NULL)
+	{
+		fclose(out);
+		out = NULL;
+	}
+}
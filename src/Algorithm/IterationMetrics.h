@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <string>
+
+// What one iteration of Skeletonization did, handed to the metrics callback
+// after the iteration (and the radius increase it may have triggered) ends.
+// The sample counts and branches are taken at the end of the iteration, the
+// neighbor counts when the WLOP step searched them.
+struct IterationMetrics
+{
+	IterationMetrics();
+
+	int iteration;         // iterations done so far, from 1
+	int stage;             // radius stage the iteration ran in, from 1
+	int stage_iteration;   // iteration within that stage, from 1
+	bool stage_converged;  // the radius was increased after it
+	double radius;         // "CGrid Radius" the iteration ran with
+	double error;          // mean movement of the moving samples
+	double percentile_error;
+
+	int moving_samples;
+	int frozen_samples;    // moving samples skipped while frozen
+	int fixed_samples;
+	int branch_samples;
+	int ignored_samples;
+	int branches;
+
+	// ball neighbors of the samples among the samples and the original
+	double mean_neighbors;
+	int max_neighbors;
+	double mean_original_neighbors;
+	int max_original_neighbors;
+
+	// seconds
+	double follow_seconds;     // branches following the samples, virtual tails
+	double neighbor_seconds;   // neighbor searches, eigen and density
+	double average_seconds;
+	double repulsion_seconds;
+	double move_seconds;       // moving the samples, with the acceleration
+	double grow_seconds;       // steps 1 to 3 after the stage converged
+	double total_seconds;
+};
+
+typedef std::function<void(const IterationMetrics&)> IterationMetricsCallback;
+
+// Writes the metrics one line per iteration, as CSV with a header line or
+// as JSON lines. Every line is flushed, so a running job can be followed.
+class IterationMetricsWriter
+{
+public:
+	enum FORMAT{CSV = 0, JSONL = 1};
+
+	IterationMetricsWriter();
+	~IterationMetricsWriter();
+
+	// "csv" or "jsonl", -1 if unknown
+	static int formatFromName(const std::string& name);
+
+	bool open(const std::string& filename, int format, std::string& error);
+	void write(const IterationMetrics& m);
+	void close();
+
+private:
+	IterationMetricsWriter(const IterationMetricsWriter&);
+	IterationMetricsWriter& operator=(const IterationMetricsWriter&);
+
+	FILE* out;
+	int format;
+};
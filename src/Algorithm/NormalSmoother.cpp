@@ -27,7 +27,7 @@ void NormalSmoother::setInput(DataMgr* pData)
 	}
 	else
 	{
-		cout << "ERROR: NormalSmoother::setInput: empty!!" << endl;
+		LOG_ERROR << "ERROR: NormalSmoother::setInput: empty!!";
 		return;
 	}
 }
@@ -36,7 +36,7 @@ void NormalSmoother::run()
 {
 	if(mesh == NULL )
 	{
-		cout << "ERROR: NormalSmoother::run() mesh == NULL || original == NULL";
+		LOG_ERROR << "ERROR: NormalSmoother::run() mesh == NULL || original == NULL";
 		return;
 	}
 
@@ -59,7 +59,7 @@ void NormalSmoother::input(CMesh* _mesh)
 {
 	if(_mesh == NULL)
 	{
-		cout << "ERROR:  NormalSmoother::setInput mesh == NULL!!" << endl;
+		LOG_ERROR << "ERROR:  NormalSmoother::setInput mesh == NULL!!";
 		system("Pause");
 		return;
 	}
@@ -113,19 +113,19 @@ void Branch::reverseBranch()
 	back_up_tail = temp;
 }
 
-bool Branch::isVirtualHeadHealthy()
+bool Branch::isVirtualHeadHealthy(RichParameterSet* para)
 {
 	if (!isHeadVirtual())
 	{
 		return false;
 	}
 
-	double save_virtual_angle = global_paraMgr.skeleton.getDouble("Save Virtual Angle");
-	double save_virtual_dist = global_paraMgr.skeleton.getDouble("Branches Merge Max Dist");
+	double save_virtual_angle = para->getDouble("Save Virtual Angle");
+	double save_virtual_dist = para->getDouble("Branches Merge Max Dist");
 
 	double head_length = GlobalFun::computeEulerDist(curve[0].P(), curve[1].P());
-	double bad_virtual_angle = global_paraMgr.skeleton.getDouble("Bad Virtual Angle");
-	double follow_dist = global_paraMgr.skeleton.getDouble("Follow Sample Radius");
+	double bad_virtual_angle = para->getDouble("Bad Virtual Angle");
+	double follow_dist = para->getDouble("Follow Sample Radius");
 
 	double angle = getHeadAngle();
 	if (angle > bad_virtual_angle || head_length > follow_dist)
@@ -143,17 +143,17 @@ bool Branch::isVirtualHeadHealthy()
 	}
 }
 
-bool Branch::isVirtualTailHealthy()
+bool Branch::isVirtualTailHealthy(RichParameterSet* para)
 {
 	if (!isTailVirtual())
 	{
 		return false;
 	}
 
-	double save_virtual_angle = global_paraMgr.skeleton.getDouble("Save Virtual Angle");
-	double save_virtual_dist = global_paraMgr.skeleton.getDouble("Branches Merge Max Dist");
-	double bad_virtual_angle = global_paraMgr.skeleton.getDouble("Bad Virtual Angle");
-	double follow_dist = global_paraMgr.skeleton.getDouble("Follow Sample Radius");
+	double save_virtual_angle = para->getDouble("Save Virtual Angle");
+	double save_virtual_dist = para->getDouble("Branches Merge Max Dist");
+	double bad_virtual_angle = para->getDouble("Bad Virtual Angle");
+	double follow_dist = para->getDouble("Follow Sample Radius");
 
 	double angle = getTailAngle();
 	double tail_length = getTailLengthEulerDist();
@@ -173,9 +173,9 @@ bool Branch::isVirtualTailHealthy()
 	}
 }
 
-void Branch::rememberVirtualHead()
+void Branch::rememberVirtualHead(RichParameterSet* para)
 {
-	if (!isVirtualHeadHealthy())
+	if (!isVirtualHeadHealthy(para))
 	{
 		return;
 	}
@@ -200,9 +200,9 @@ void Branch::rememberVirtualHead()
 	}
 }
 
-void Branch::rememberVirtualTail()
+void Branch::rememberVirtualTail(RichParameterSet* para)
 {
-	if (!isVirtualTailHealthy())
+	if (!isVirtualTailHealthy(para))
 	{
 		return;
 	}
@@ -276,11 +276,11 @@ void Skeleton::generateBranchSampleMap()
 
 void Skeleton::saveToPCD(const std::string & filename)
 {
+  Profiler::Scope profile("saveToPCD");
   typedef pcl::PointXYZL PointT;
   typedef pcl::PointCloud<PointT> CloudT;
   
-  printf("\nWriting %lu branches to the PCD file: %s\n",
-         branches.size(), filename.c_str());
+  LOG_INFO << "Writing " << branches.size() << " branches to the PCD file: " << filename;
 
   CloudT::Ptr cloud(new CloudT);
   
@@ -38,10 +38,10 @@ public:
 	bool isEmpty();
 	bool isHeadVirtual(){return curve[0].is_skel_virtual;}
 	bool isTailVirtual(){return curve[curve.size()-1].is_skel_virtual;}
-	bool isVirtualHeadHealthy();
-	bool isVirtualTailHealthy();
-	void rememberVirtualHead();
-	void rememberVirtualTail();
+	bool isVirtualHeadHealthy(RichParameterSet* para = &global_paraMgr.skeleton);
+	bool isVirtualTailHealthy(RichParameterSet* para = &global_paraMgr.skeleton);
+	void rememberVirtualHead(RichParameterSet* para = &global_paraMgr.skeleton);
+	void rememberVirtualTail(RichParameterSet* para = &global_paraMgr.skeleton);
 
 	double getNodeAngle(int idx);
 	double getHeadAngle(){return getNodeAngle(0);}
@@ -1,7 +1,13 @@
 #include "Skeletonization.h"
+#include "octree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 
 void Skeletonization::run_full(DataMgr* data)
 {
+  Profiler::Scope profile("run_full");
   // run until completion
   int i = 0; 
   do {
@@ -10,13 +16,679 @@ void Skeletonization::run_full(DataMgr* data)
     setInput(data);  
     // I *think* this is the best choice here...
 		runAutoWlopOneStep();
+    if (checkpoint_interval > 0 && nTimeIterated % checkpoint_interval == 0 &&
+        !para->getBool("The Skeletonlization Process Should Stop"))
+    {
+      saveCheckpoint(data, checkpoint_file);
+    }
     clear();
-    std::cout << "Iteration " << i << std::endl;
+    LOG_DEBUG << "Iteration " << i;
     i++;
   } while (!para->getBool("The Skeletonlization Process Should Stop"));
-  std::cout << "Completed skeletonization with "
-            << data->getCurrentSkeleton()->branches.size() << " branches."
-            << std::endl;
+  if (checkpoint_interval > 0)
+  {
+    std::remove(checkpoint_file.c_str());
+  }
+  LOG_INFO << "Completed skeletonization with "
+           << data->getCurrentSkeleton()->branches.size() << " branches.";
+
+  int total = 0;
+  std::ostringstream stages;
+  for (int s = 0; s < stage_iterations.size(); s++) {
+    stages << " " << stage_iterations[s];
+    total += stage_iterations[s];
+  }
+  LOG_INFO << "Iterations per radius stage:" << stages.str() << " ("
+           << stage_iterations.size() << " stages, " << total << " iterations)";
+  if (accelerator.isEnabled()) {
+    LOG_INFO << "Accelerated steps: " << accelerator.getAcceleratedNum()
+             << ", fallbacks to the plain step: " << accelerator.getFallbackNum();
+  }
+}
+
+// Coarse-to-fine skeletonization. The input is downsampled level_ratio times
+// per level; every level is seeded with the skeleton of the coarser one and
+// starts at the radius the coarser level started with, so only the coarsest
+// level walks through the small radius stages. The coarse levels take their
+// samples with the same method as the full samples, on a copy of the
+// parameters: the radius each level derives must not leak into the shared
+// sets.
+void Skeletonization::run_pyramid(DataMgr* data, int levels, double level_ratio, int sampling_method)
+{
+  Profiler::Scope profile("run_pyramid");
+  int min_level_samples = 200;
+  int sample_num = data->samples.vn;
+  int original_num = data->original.vn;
+  while (levels > 1 && sample_num / pow(level_ratio, levels - 1) < min_level_samples)
+  {
+    levels--;
+  }
+
+  if (levels <= 1 || level_ratio <= 1)
+  {
+    run_full(data);
+    return;
+  }
+
+  double radius = para->getDouble("CGrid Radius");
+  Skeleton coarse;
+  double coarse_radius = -1;
+
+  for (int level = 0; level < levels; level++)
+  {
+    double scale = pow(level_ratio, levels - 1 - level);
+    double level_radius = radius * pow(scale, 1.0 / 3.0); // radius grows with the point spacing
+    double start_radius = coarse_radius > 0 ? coarse_radius : level_radius;
+
+    LOG_INFO << "Pyramid level " << level << ": samples " << int(sample_num / scale)
+             << " original " << int(original_num / scale)
+             << " start radius " << start_radius;
+
+    ParameterMgr level_paras(*data->paraMgr);
+    DataMgr level_data(level_paras.getDataParameterSet(), &level_paras);
+    DataMgr* curr_data = data;
+    if (level < levels - 1)
+    {
+      level_data.downOriginalByNum(data->original, original_num / scale);
+      level_data.downSamplesByMethod(sampling_method, sample_num / scale);
+      curr_data = &level_data;
+    }
+
+    para->setValue("The Skeletonlization Process Should Stop", BoolValue(false));
+    para->setValue("Initial Radius", DoubleValue(level_radius));
+    para->setValue("CGrid Radius", DoubleValue(start_radius));
+
+    Skeletonization level_algo(para);
+    Skeletonization* algo = level < levels - 1 ? &level_algo : this;
+    algo->setFirstIterate();
+    if (!coarse.isEmpty())
+    {
+      algo->seedFromSkeleton(curr_data, coarse);
+    }
+    algo->run_full(curr_data);
+
+    coarse = *curr_data->getCurrentSkeleton();
+    coarse_radius = level_radius;
+  }
+}
+
+// Turn the branches of a skeleton computed on another (coarser) point set into
+// branches of this one: every node grabs the nearest moving sample, which is
+// put onto the node and fixed as a branch point.
+void Skeletonization::seedFromSkeleton(DataMgr* data, Skeleton& coarse)
+{
+  setInput(data);
+  if (samples == NULL)
+  {
+    return;
+  }
+
+  for (int i = 0; i < samples->vert.size(); i++)
+  {
+    samples->vert[i].m_index = i;
+  }
+
+  double snap_radius = para->getDouble("CGrid Radius");
+  COctree octree;
+  octree.init(samples->vert);
+
+  struct NearestMoving
+  {
+    Point3f p;
+    double min_dist2;
+    CVertex* nearest;
+    void operator()(CVertex& t)
+    {
+      double dist2 = (t.P() - p).SquaredNorm();
+      if (t.isSample_Moving() && dist2 < min_dist2)
+      {
+        min_dist2 = dist2;
+        nearest = &t;
+      }
+    }
+    void operator()(const Point3f&, int){}
+  };
+
+  int seeded = 0;
+  for (int i = 0; i < coarse.branches.size(); i++)
+  {
+    Curve& coarse_curve = coarse.branches[i].curve;
+    Branch new_branch;
+
+    for (int j = 0; j < coarse_curve.size(); j++)
+    {
+      CVertex& node = coarse_curve[j];
+      NearestMoving nearest;
+      nearest.p = node.P();
+      nearest.min_dist2 = GlobalFun::getDoubleMAXIMUM();
+      nearest.nearest = NULL;
+      octree.query(node.P(), snap_radius, 0, nearest, nearest);
+      if (nearest.nearest == NULL)
+      {
+        continue;
+      }
+
+      CVertex& v = *nearest.nearest;
+      v.P() = node.P();
+      v.setSample_FixedAndBranched();
+
+      CVertex new_node = v;
+      new_node.neighbors.clear();
+      new_node.original_neighbors.clear();
+      new_node.skel_radius = node.skel_radius;
+      new_branch.pushBackCVertex(new_node);
+    }
+
+    if (new_branch.getSize() < 2)
+    {
+      for (int j = 0; j < new_branch.getSize(); j++)
+      {
+        samples->vert[new_branch.curve[j].m_index].setSample_JustMoving();
+      }
+      continue;
+    }
+
+    skeleton->branches.push_back(new_branch);
+    seeded++;
+  }
+  skeleton->generateBranchSampleMap();
+
+  labelFixOriginal();
+  is_warm_started = true;
+
+  LOG_INFO << "Seeded " << seeded << " branches from the coarse skeleton";
+  clear();
+}
+
+// Join the branches of a skeleton put together from separately computed parts
+// (the tiles of a large cloud): ends of different parts that lie within
+// merge_dist are merged as in a radius stage, then branches that share an end
+// are reconnected. merge_dist <= 0 keeps "Branches Merge Max Dist".
+void Skeletonization::stitchSkeleton(Skeleton& parts, double merge_dist)
+{
+  double stage_merge_dist = para->getDouble("Branches Merge Max Dist");
+  if (merge_dist > 0)
+  {
+    para->setValue("Branches Merge Max Dist", DoubleValue(merge_dist));
+  }
+
+  skeleton = &parts;
+  is_skeleton_locked = false;
+  skeleton->generateBranchSampleMap();
+  int part_branches = skeleton->branches.size();
+
+  mergeNearEndsGroup();
+  reconnectSkeleton();
+  skeleton->generateBranchSampleMap();
+
+  LOG_INFO << "Stitched " << part_branches << " branches into "
+           << skeleton->branches.size();
+  para->setValue("Branches Merge Max Dist", DoubleValue(stage_merge_dist));
+  skeleton = NULL;
+}
+
+static Point3f transformPoint(const float* m, const Point3f& p, float w)
+{
+  return Point3f(m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3] * w,
+                 m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7] * w,
+                 m[8] * p[0] + m[9] * p[1] + m[10] * p[2] + m[11] * w);
+}
+
+// Start the next frame of a sequence from the result of the last run: data
+// still holds the converged samples and the skeleton of the previous frame,
+// only its original has been replaced by the new frame. Both are moved by the
+// rigid motion (row-major 4x4, may be NULL), samples left without any new
+// point within the resume radius are put onto their nearest new point, and the
+// old branches are seeded on the samples again. The frame then resumes at the
+// radius of stage resume_stage of the previous frame, keeping its
+// "Initial Radius". Returns false if there is nothing to start from.
+bool Skeletonization::warmStartFromPrevious(DataMgr* data, const float* motion, int resume_stage)
+{
+  vector<double> previous_radii = stage_radii;
+  if (data->isSamplesEmpty() || data->isOriginalEmpty() || previous_radii.empty())
+  {
+    return false;
+  }
+
+  CMesh* frame_samples = data->getCurrentSamples();
+  CMesh* frame_original = data->getCurrentOriginal();
+  Skeleton previous = *data->getCurrentSkeleton();
+
+  if (motion != NULL)
+  {
+    for (int i = 0; i < frame_samples->vert.size(); i++)
+    {
+      CVertex& v = frame_samples->vert[i];
+      v.P() = transformPoint(motion, v.P(), 1);
+      v.N() = transformPoint(motion, v.N(), 0);
+    }
+    for (int i = 0; i < previous.branches.size(); i++)
+    {
+      Curve& curve = previous.branches[i].curve;
+      for (int j = 0; j < curve.size(); j++)
+      {
+        curve[j].P() = transformPoint(motion, curve[j].P(), 1);
+      }
+    }
+  }
+
+  if (resume_stage < 0)
+  {
+    resume_stage = 0;
+  }
+  if (resume_stage >= previous_radii.size())
+  {
+    resume_stage = previous_radii.size() - 1;
+  }
+  double radius = previous_radii[resume_stage];
+
+  // samples in parts of the shape that moved away get back onto the points
+  COctree octree;
+  octree.init(frame_original->vert);
+  double max_radius = frame_original->bbox.Diag();
+  int reprojected = 0;
+
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:reprojected)
+  for (int i = 0; i < frame_samples->vert.size(); i++)
+  {
+    CVertex& v = frame_samples->vert[i];
+    if (v.is_skel_ignore)
+    {
+      continue;
+    }
+
+    struct Nearest
+    {
+      Point3f p;
+      double min_dist2;
+      CVertex* nearest;
+      void operator()(CVertex& t)
+      {
+        double dist2 = (t.P() - p).SquaredNorm();
+        if (dist2 < min_dist2)
+        {
+          min_dist2 = dist2;
+          nearest = &t;
+        }
+      }
+      void operator()(const Point3f&, int){}
+    };
+
+    Nearest nearest;
+    nearest.p = v.P();
+    nearest.min_dist2 = GlobalFun::getDoubleMAXIMUM();
+    nearest.nearest = NULL;
+    octree.query(v.P(), radius, 0, nearest, nearest);
+    if (nearest.nearest != NULL)
+    {
+      continue;
+    }
+
+    for (double r = 2 * radius; nearest.nearest == NULL && r < 2 * max_radius; r *= 2)
+    {
+      octree.query(v.P(), r, 0, nearest, nearest);
+    }
+    if (nearest.nearest != NULL)
+    {
+      v.P() = nearest.nearest->P();
+      reprojected++;
+    }
+  }
+
+  frame_samples->bbox.SetNull();
+  for (int i = 0; i < frame_samples->vert.size(); i++)
+  {
+    CVertex& v = frame_samples->vert[i];
+    if (!v.is_skel_ignore)
+    {
+      v.setSample_JustMoving();
+    }
+    frame_samples->bbox.Add(v.P());
+  }
+  data->getCurrentSkeleton()->clear();
+
+  nTimeIterated = 0;
+  stage_iterations.clear();
+  stage_radii.clear();
+  still_iterations.clear();
+  accelerator.restart();
+  para->setValue("The Skeletonlization Process Should Stop", BoolValue(false));
+  para->setValue("CGrid Radius", DoubleValue(radius));
+
+  LOG_INFO << "Warm start: " << reprojected << " samples put back onto the new points, "
+           << "resuming at radius " << radius << " (stage " << resume_stage << ")";
+  seedFromSkeleton(data, previous);
+  return true;
+}
+
+// Checkpoints hold the complete state of an iteration in the binary format of
+// PointIO::SkelWriter: every sample and node with all of its persistent
+// fields, the branches, the counters and stage history of the algorithm, the
+// parameters the algorithm changes while it runs, the original density and the
+// history of the accelerator. The original itself is only identified by its
+// hash, a resumed run loads it from the input again.
+enum CHECKPOINT_FLAG { CKPT_FIXED = 1, CKPT_BRANCH = 2, CKPT_VIRTUAL = 4, CKPT_IGNORE = 8,
+                       CKPT_FIXED_ORIGINAL = 16 };
+
+static const char* checkpoint_double_params[] = { "CGrid Radius", "Initial Radius",
+  "Branches Merge Max Dist", "Current Movement Error" };
+static const char* checkpoint_bool_params[] = { "Need Segment Right Away",
+  "The Skeletonlization Process Should Stop" };
+
+static void addVertices(PointIO::SkelWriter& writer, const std::string& prefix, const Curve& vert)
+{
+  int n = vert.size();
+  vector<float> position(3 * n), normal(3 * n), eigen0(3 * n), eigen1(3 * n);
+  vector<double> confidence(n), radius(n);
+  vector<int> index(n);
+  vector<unsigned char> flags(n);
+  for (int i = 0; i < n; i++)
+  {
+    const CVertex& v = vert[i];
+    for (int k = 0; k < 3; k++)
+    {
+      position[3 * i + k] = v.cP()[k];
+      normal[3 * i + k] = v.cN()[k];
+      eigen0[3 * i + k] = v.eigen_vector0[k];
+      eigen1[3 * i + k] = v.eigen_vector1[k];
+    }
+    confidence[i] = v.eigen_confidence;
+    radius[i] = v.skel_radius;
+    index[i] = v.m_index;
+    flags[i] = (v.is_fixed_sample ? CKPT_FIXED : 0) | (v.is_skel_branch ? CKPT_BRANCH : 0) |
+               (v.is_skel_virtual ? CKPT_VIRTUAL : 0) | (v.is_skel_ignore ? CKPT_IGNORE : 0) |
+               (v.is_fixed_original ? CKPT_FIXED_ORIGINAL : 0);
+  }
+  writer.add(prefix + ".position", PointIO::SKEL_F32, 3, n, position.data());
+  writer.add(prefix + ".normal", PointIO::SKEL_F32, 3, n, normal.data());
+  writer.add(prefix + ".eigen0", PointIO::SKEL_F32, 3, n, eigen0.data());
+  writer.add(prefix + ".eigen1", PointIO::SKEL_F32, 3, n, eigen1.data());
+  writer.add(prefix + ".confidence", PointIO::SKEL_F64, 1, n, confidence.data());
+  writer.add(prefix + ".radius", PointIO::SKEL_F64, 1, n, radius.data());
+  writer.add(prefix + ".index", PointIO::SKEL_I32, 1, n, index.data());
+  writer.add(prefix + ".flags", PointIO::SKEL_U8, 1, n, flags.data());
+}
+
+static bool readVertices(const PointIO::SkelReader& reader, const std::string& prefix, Curve& vert)
+{
+  const PointIO::SkelSection* s[8] = {
+    reader.find(prefix + ".position", PointIO::SKEL_F32, 3),
+    reader.find(prefix + ".normal", PointIO::SKEL_F32, 3),
+    reader.find(prefix + ".eigen0", PointIO::SKEL_F32, 3),
+    reader.find(prefix + ".eigen1", PointIO::SKEL_F32, 3),
+    reader.find(prefix + ".confidence", PointIO::SKEL_F64, 1),
+    reader.find(prefix + ".radius", PointIO::SKEL_F64, 1),
+    reader.find(prefix + ".index", PointIO::SKEL_I32, 1),
+    reader.find(prefix + ".flags", PointIO::SKEL_U8, 1) };
+  for (int j = 0; j < 8; j++)
+  {
+    if (s[j] == NULL || s[j]->count != s[0]->count)
+    {
+      return false;
+    }
+  }
+
+  const float* position = (const float*)reader.data(*s[0]);
+  const float* normal = (const float*)reader.data(*s[1]);
+  const float* eigen0 = (const float*)reader.data(*s[2]);
+  const float* eigen1 = (const float*)reader.data(*s[3]);
+  const double* confidence = (const double*)reader.data(*s[4]);
+  const double* radius = (const double*)reader.data(*s[5]);
+  const int* index = (const int*)reader.data(*s[6]);
+  const unsigned char* flags = (const unsigned char*)reader.data(*s[7]);
+
+  int n = s[0]->count;
+  vert.resize(n);
+  for (int i = 0; i < n; i++)
+  {
+    CVertex& v = vert[i];
+    v.P() = Point3f(position[3 * i], position[3 * i + 1], position[3 * i + 2]);
+    v.N() = Point3f(normal[3 * i], normal[3 * i + 1], normal[3 * i + 2]);
+    v.eigen_vector0 = Point3f(eigen0[3 * i], eigen0[3 * i + 1], eigen0[3 * i + 2]);
+    v.eigen_vector1 = Point3f(eigen1[3 * i], eigen1[3 * i + 1], eigen1[3 * i + 2]);
+    v.eigen_confidence = confidence[i];
+    v.skel_radius = radius[i];
+    v.m_index = index[i];
+    v.is_fixed_sample = (flags[i] & CKPT_FIXED) != 0;
+    v.is_skel_branch = (flags[i] & CKPT_BRANCH) != 0;
+    v.is_skel_virtual = (flags[i] & CKPT_VIRTUAL) != 0;
+    v.is_skel_ignore = (flags[i] & CKPT_IGNORE) != 0;
+    v.is_fixed_original = (flags[i] & CKPT_FIXED_ORIGINAL) != 0;
+  }
+  return true;
+}
+
+// Write a checkpoint every interval iterations of run_full, an interval of 0
+// turns them off. The file is removed once the run completes.
+void Skeletonization::setCheckpoint(const std::string& file, int interval)
+{
+  checkpoint_file = file;
+  checkpoint_interval = interval;
+}
+
+void Skeletonization::setMetricsCallback(const IterationMetricsCallback& callback)
+{
+  metrics_callback = callback;
+}
+
+bool Skeletonization::saveCheckpoint(DataMgr* data, const std::string& file)
+{
+  Profiler::Scope profile("saveCheckpoint");
+  CMesh* ckpt_samples = data->getCurrentSamples();
+  CMesh* ckpt_original = data->getCurrentOriginal();
+  Skeleton* ckpt_skeleton = data->getCurrentSkeleton();
+
+  PointIO::SkelWriter writer;
+  addVertices(writer, "sample", ckpt_samples->vert);
+
+  vector<unsigned char> fixed_original(ckpt_original->vert.size());
+  for (int i = 0; i < ckpt_original->vert.size(); i++)
+  {
+    fixed_original[i] = ckpt_original->vert[i].is_fixed_original;
+  }
+  unsigned long long hash = data->hashOriginal();
+  writer.add("original.fixed", PointIO::SKEL_U8, 1, fixed_original.size(), fixed_original.data());
+  writer.add("original.hash", PointIO::SKEL_U8, 1, sizeof(hash), &hash);
+
+  // the nodes of all branches in a row, branch i owns [offset[i], offset[i+1])
+  Curve nodes;
+  vector<unsigned int> offset(1, 0);
+  vector<float> backup;
+  vector<int> branch_id;
+  for (int i = 0; i < ckpt_skeleton->branches.size(); i++)
+  {
+    Branch& branch = ckpt_skeleton->branches[i];
+    nodes.insert(nodes.end(), branch.curve.begin(), branch.curve.end());
+    offset.push_back(nodes.size());
+    for (int k = 0; k < 3; k++)
+    {
+      backup.push_back(branch.back_up_head[k]);
+    }
+    for (int k = 0; k < 3; k++)
+    {
+      backup.push_back(branch.back_up_tail[k]);
+    }
+    branch_id.push_back(branch.branch_id);
+  }
+  addVertices(writer, "node", nodes);
+  writer.add("branch.offset", PointIO::SKEL_U32, 1, offset.size(), offset.data());
+  writer.add("branch.backup", PointIO::SKEL_F32, 6, branch_id.size(), backup.data());
+  writer.add("branch.id", PointIO::SKEL_I32, 1, branch_id.size(), branch_id.data());
+
+  int counters[4] = { nTimeIterated, iterate_time_in_one_stage, is_warm_started, is_skeleton_locked };
+  double errors[3] = { error_x, iterate_error, iterate_percentile_error };
+  writer.add("state.counters", PointIO::SKEL_I32, 1, 4, counters);
+  writer.add("state.errors", PointIO::SKEL_F64, 1, 3, errors);
+  writer.add("state.stage_iterations", PointIO::SKEL_I32, 1, stage_iterations.size(), stage_iterations.data());
+  writer.add("state.stage_radii", PointIO::SKEL_F64, 1, stage_radii.size(), stage_radii.data());
+  writer.add("state.still_iterations", PointIO::SKEL_I32, 1, still_iterations.size(), still_iterations.data());
+  writer.add("state.original_density", PointIO::SKEL_F64, 1, original_density.size(), original_density.data());
+
+  int double_num = sizeof(checkpoint_double_params) / sizeof(checkpoint_double_params[0]);
+  int bool_num = sizeof(checkpoint_bool_params) / sizeof(checkpoint_bool_params[0]);
+  vector<double> double_values;
+  vector<unsigned char> bool_values;
+  for (int i = 0; i < double_num; i++)
+  {
+    double_values.push_back(para->getDouble(checkpoint_double_params[i]));
+  }
+  for (int i = 0; i < bool_num; i++)
+  {
+    bool_values.push_back(para->getBool(checkpoint_bool_params[i]));
+  }
+  writer.add("param.double", PointIO::SKEL_F64, 1, double_num, double_values.data());
+  writer.add("param.bool", PointIO::SKEL_U8, 1, bool_num, bool_values.data());
+
+  accelerator.save(writer);
+
+  // a crash while writing must not destroy the last good checkpoint
+  std::string error;
+  std::string temp = file + ".tmp";
+  if (!writer.write(temp, error) || std::rename(temp.c_str(), file.c_str()) != 0)
+  {
+    LOG_WARN << "Could not write checkpoint " << file << ": " << error;
+    std::remove(temp.c_str());
+    return false;
+  }
+  LOG_INFO << "Checkpoint written to " << file << " at iteration " << nTimeIterated;
+  return true;
+}
+
+// Restore the state of saveCheckpoint into data, whose original has to be the
+// one the checkpoint was written with. run_full then continues exactly where
+// the checkpointed run was.
+bool Skeletonization::loadCheckpoint(DataMgr* data, const std::string& file)
+{
+  Profiler::Scope profile("loadCheckpoint");
+  PointIO::SkelReader reader;
+  std::string error;
+  if (!reader.open(file, error))
+  {
+    LOG_ERROR << error;
+    return false;
+  }
+
+  CMesh* ckpt_original = data->getCurrentOriginal();
+  const PointIO::SkelSection* hash = reader.find("original.hash", PointIO::SKEL_U8, 1);
+  const PointIO::SkelSection* fixed = reader.find("original.fixed", PointIO::SKEL_U8, 1);
+  unsigned long long original_hash = data->hashOriginal();
+  if (hash == NULL || hash->count != sizeof(original_hash) || fixed == NULL ||
+      fixed->count != ckpt_original->vert.size() ||
+      memcmp(reader.data(*hash), &original_hash, sizeof(original_hash)) != 0)
+  {
+    LOG_ERROR << file << " was written for other original points";
+    return false;
+  }
+
+  const PointIO::SkelSection* counters = reader.find("state.counters", PointIO::SKEL_I32, 1);
+  const PointIO::SkelSection* errors = reader.find("state.errors", PointIO::SKEL_F64, 1);
+  const PointIO::SkelSection* iterations = reader.find("state.stage_iterations", PointIO::SKEL_I32, 1);
+  const PointIO::SkelSection* radii = reader.find("state.stage_radii", PointIO::SKEL_F64, 1);
+  const PointIO::SkelSection* still = reader.find("state.still_iterations", PointIO::SKEL_I32, 1);
+  const PointIO::SkelSection* density = reader.find("state.original_density", PointIO::SKEL_F64, 1);
+  const PointIO::SkelSection* offset = reader.find("branch.offset", PointIO::SKEL_U32, 1);
+  const PointIO::SkelSection* backup = reader.find("branch.backup", PointIO::SKEL_F32, 6);
+  const PointIO::SkelSection* branch_id = reader.find("branch.id", PointIO::SKEL_I32, 1);
+  const PointIO::SkelSection* double_values = reader.find("param.double", PointIO::SKEL_F64, 1);
+  const PointIO::SkelSection* bool_values = reader.find("param.bool", PointIO::SKEL_U8, 1);
+  int double_num = sizeof(checkpoint_double_params) / sizeof(checkpoint_double_params[0]);
+  int bool_num = sizeof(checkpoint_bool_params) / sizeof(checkpoint_bool_params[0]);
+
+  Curve sample_vert, nodes;
+  if (counters == NULL || counters->count != 4 || errors == NULL || errors->count != 3 ||
+      iterations == NULL || radii == NULL || still == NULL || density == NULL ||
+      offset == NULL || offset->count == 0 || backup == NULL || branch_id == NULL ||
+      backup->count + 1 != offset->count || branch_id->count + 1 != offset->count ||
+      double_values == NULL || double_values->count != double_num ||
+      bool_values == NULL || bool_values->count != bool_num ||
+      !readVertices(reader, "sample", sample_vert) || !readVertices(reader, "node", nodes))
+  {
+    LOG_ERROR << file << " is not a complete checkpoint";
+    return false;
+  }
+
+  Skeleton restored;
+  const unsigned int* first = (const unsigned int*)reader.data(*offset);
+  const float* back_up = (const float*)reader.data(*backup);
+  const int* id = (const int*)reader.data(*branch_id);
+  for (int i = 0; i + 1 < offset->count; i++)
+  {
+    if (first[i] > first[i + 1] || first[i + 1] > nodes.size())
+    {
+      LOG_ERROR << "bad branch offsets in " << file;
+      return false;
+    }
+    Branch branch;
+    branch.curve.assign(nodes.begin() + first[i], nodes.begin() + first[i + 1]);
+    branch.back_up_head = Point3f(back_up[6 * i], back_up[6 * i + 1], back_up[6 * i + 2]);
+    branch.back_up_tail = Point3f(back_up[6 * i + 3], back_up[6 * i + 4], back_up[6 * i + 5]);
+    branch.branch_id = id[i];
+    restored.branches.push_back(branch);
+  }
+
+  if (!accelerator.load(reader))
+  {
+    LOG_ERROR << file << " has no accelerator state";
+    return false;
+  }
+
+  CMesh* ckpt_samples = data->getCurrentSamples();
+  ckpt_samples->vert.clear();
+  ckpt_samples->bbox.SetNull();
+  vcg::tri::Allocator<CMesh>::AddVertices(*ckpt_samples, sample_vert.size());
+  for (int i = 0; i < sample_vert.size(); i++)
+  {
+    CVertex& v = ckpt_samples->vert[i];
+    v = sample_vert[i];
+    v.bIsOriginal = false;
+    ckpt_samples->bbox.Add(v.P());
+  }
+  ckpt_samples->vn = ckpt_samples->vert.size();
+
+  const unsigned char* fixed_original = (const unsigned char*)reader.data(*fixed);
+  for (int i = 0; i < ckpt_original->vert.size(); i++)
+  {
+    ckpt_original->vert[i].is_fixed_original = fixed_original[i] != 0;
+  }
+
+  Skeleton* ckpt_skeleton = data->getCurrentSkeleton();
+  ckpt_skeleton->clear();
+  ckpt_skeleton->branches = restored.branches;
+  ckpt_skeleton->generateBranchSampleMap();
+
+  const int* counter = (const int*)reader.data(*counters);
+  nTimeIterated = counter[0];
+  iterate_time_in_one_stage = counter[1];
+  is_warm_started = counter[2] != 0;
+  is_skeleton_locked = counter[3] != 0;
+  const double* error_values = (const double*)reader.data(*errors);
+  error_x = error_values[0];
+  iterate_error = error_values[1];
+  iterate_percentile_error = error_values[2];
+
+  const int* stage_iteration = (const int*)reader.data(*iterations);
+  stage_iterations.assign(stage_iteration, stage_iteration + iterations->count);
+  const double* stage_radius = (const double*)reader.data(*radii);
+  stage_radii.assign(stage_radius, stage_radius + radii->count);
+  const int* still_iteration = (const int*)reader.data(*still);
+  still_iterations.assign(still_iteration, still_iteration + still->count);
+  const double* original_density_values = (const double*)reader.data(*density);
+  original_density.assign(original_density_values, original_density_values + density->count);
+
+  const double* param_double = (const double*)reader.data(*double_values);
+  const unsigned char* param_bool = (const unsigned char*)reader.data(*bool_values);
+  for (int i = 0; i < double_num; i++)
+  {
+    para->setValue(checkpoint_double_params[i], DoubleValue(param_double[i]));
+  }
+  for (int i = 0; i < bool_num; i++)
+  {
+    para->setValue(checkpoint_bool_params[i], BoolValue(param_bool[i] != 0));
+  }
+
+  LOG_INFO << "Resumed from " << file << " at iteration " << nTimeIterated << ", radius "
+           << para->getDouble("CGrid Radius");
+  return true;
 }
 
 void Skeletonization::run()
@@ -26,7 +698,7 @@ void Skeletonization::run()
 	if (para->getBool("Run Auto Wlop One Step"))
 	{
 		runAutoWlopOneStep();
-		cout << "**************iterate Number: " << nTimeIterated << endl;
+		LOG_DEBUG << "**************iterate Number: " << nTimeIterated;
 	}
 
 	if (para->getBool("Step1 Detect Skeleton Feature"))
@@ -52,12 +724,36 @@ void Skeletonization::run()
 
 void Skeletonization::runAutoWlopOneStep()
 {
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point iteration_start = Clock::now();
+	metrics = IterationMetrics();
+	metrics.stage = stage_iterations.size() + 1;
+	metrics.radius = para->getDouble("CGrid Radius");
+
 	runStep0_WLOPIterationAndBranchGrowing();
 
-	if (iterate_error < para->getDouble("Stop And Grow Error") || 
+	metrics.iteration = nTimeIterated;
+	metrics.stage_iteration = iterate_time_in_one_stage;
+	metrics.error = iterate_error;
+	metrics.percentile_error = iterate_percentile_error;
+
+	double stage_error = iterate_error;
+	if (para->getDouble("Stop Error Percentile") > 0)
+	{
+		stage_error = iterate_percentile_error;
+	}
+
+	if (stage_error < para->getDouble("Stop And Grow Error") || 
 	   	iterate_time_in_one_stage > para->getDouble("Max Iterate Time"))
 	{
-		cout << "!!!!!!!!!!!!!! Increase Radius Begin !!!!!!!!!!!!!!" << endl;
+		stage_iterations.push_back(iterate_time_in_one_stage);
+		stage_radii.push_back(para->getDouble("CGrid Radius"));
+		LOG_INFO << "Stage " << stage_iterations.size() << " converged after "
+		     << iterate_time_in_one_stage << " iterations";
+
+		LOG_DEBUG << "!!!!!!!!!!!!!! Increase Radius Begin !!!!!!!!!!!!!!";
+		metrics.stage_converged = true;
+		Clock::time_point grow_start = Clock::now();
 
 		runStep1_DetectFeaturePoints();
 		runStep2_SearchNewBranches();
@@ -78,16 +774,77 @@ void Skeletonization::runAutoWlopOneStep()
 		{
 			para->setValue("The Skeletonlization Process Should Stop", BoolValue(true));
 		}
+		metrics.grow_seconds = std::chrono::duration<double>(Clock::now() - grow_start).count();
 
 
-		cout << "!!!!!!!!!!!!!! Increase Radius End !!!!!!!!!!!!!!" << endl;
+		LOG_DEBUG << "!!!!!!!!!!!!!! Increase Radius End !!!!!!!!!!!!!!";
     iterate_time_in_one_stage = 0;
+    still_iterations.assign(samples->vn, 0);
+    accelerator.reset();
+	}
+
+	if (metrics_callback)
+	{
+		collectSampleMetrics();
+		metrics.total_seconds = std::chrono::duration<double>(Clock::now() - iteration_start).count();
+		metrics_callback(metrics);
 	}
 }
 
+// sample-sample and sample-original neighbor counts of the WLOP step
+void Skeletonization::collectNeighborMetrics()
+{
+	double sum = 0, original_sum = 0;
+	int max_count = 0, max_original = 0;
+	for (int i = 0; i < samples->vert.size(); i++)
+	{
+		CVertex& v = samples->vert[i];
+		sum += v.neighbors.size();
+		original_sum += v.original_neighbors.size();
+		max_count = MyMax(max_count, int(v.neighbors.size()));
+		max_original = MyMax(max_original, int(v.original_neighbors.size()));
+	}
+	int n = MyMax(int(samples->vert.size()), 1);
+	metrics.mean_neighbors = sum / n;
+	metrics.max_neighbors = max_count;
+	metrics.mean_original_neighbors = original_sum / n;
+	metrics.max_original_neighbors = max_original;
+}
+
+// what the samples are at the end of the iteration
+void Skeletonization::collectSampleMetrics()
+{
+	for (int i = 0; i < samples->vert.size(); i++)
+	{
+		CVertex& v = samples->vert[i];
+		if (v.is_skel_ignore)
+		{
+			metrics.ignored_samples++;
+		}
+		else if (v.is_skel_branch)
+		{
+			metrics.branch_samples++;
+		}
+		else if (v.is_fixed_sample)
+		{
+			metrics.fixed_samples++;
+		}
+		else
+		{
+			metrics.moving_samples++;
+			if (i < is_sample_frozen.size() && is_sample_frozen[i])
+			{
+				metrics.frozen_samples++;
+			}
+		}
+	}
+	metrics.branches = skeleton->branches.size();
+}
+
 
 void Skeletonization::finalProcess()
 {
+  Profiler::Scope profile("finalProcess");
   para->setValue("The Skeletonlization Process Should Stop", BoolValue(true));
 
   dealWithVirtualsForAllBranch();
@@ -129,30 +886,38 @@ void Skeletonization::finalProcess()
 
 void Skeletonization::runStep0_WLOPIterationAndBranchGrowing()
 {
+  Profiler::Scope profile("runStep0");
   if (nTimeIterated == 0)
   {
-    double init_radius = para->getDouble("CGrid Radius");
-    para->setValue("Initial Radius", DoubleValue(init_radius));
+    if (!is_warm_started)
+    {
+      double init_radius = para->getDouble("CGrid Radius");
+      para->setValue("Initial Radius", DoubleValue(init_radius));
+    }
     iterate_time_in_one_stage = 0;
   }
 	
   time.start("updateAllCurvesFollowSamples()");
   updateAllBranchesFollowSamples();
   time.end();
+  metrics.follow_seconds = time.getTimeUsed();
 
   time.start("growAllCurvesWithVirtual()");
   growAllBranches();
   time.end();
+  metrics.follow_seconds += time.getTimeUsed();
 
   time.start("dealWithVirtualsForAllCurve()");
   dealWithVirtualsForAllBranch();
   time.end();
+  metrics.follow_seconds += time.getTimeUsed();
 
   if (para->getBool("Use Clean Points When Following Strategy"))
   {
     time.start("cleanPointsNearBranches()");
     cleanPointsNearBranches();
     time.end();
+    metrics.follow_seconds += time.getTimeUsed();
   }
 
   iterate_error = wlopIterate();
@@ -160,53 +925,84 @@ void Skeletonization::runStep0_WLOPIterationAndBranchGrowing()
   
 	iterate_time_in_one_stage++;
 	nTimeIterated ++;
-	cout << "&&&&&&Iterated: " << nTimeIterated << endl;
+	LOG_DEBUG << "&&&&&&Iterated: " << nTimeIterated;
 }
 
 void Skeletonization::runStep1_DetectFeaturePoints()
 {
-	cout << "runStep1_DetectFeaturePoints" << endl;
+	Profiler::Scope profile("runStep1");
+	LOG_DEBUG << "runStep1_DetectFeaturePoints";
 
+	time.start("removeTooClosePoints()");
 	removeTooClosePoints();
+	time.end();
 
+	time.start("eigenThresholdIdentification()");
 	eigenThresholdIdentification();
+	time.end();
 }
 
 void Skeletonization::runStep2_SearchNewBranches()
 {
-	cout << "runStep2_SearchNewBranches" << endl;
+	Profiler::Scope profile("runStep2");
+	LOG_DEBUG << "runStep2_SearchNewBranches";
 
+	time.start("searchNewBranches()");
 	searchNewBranches();
+	time.end();
 
+	time.start("growAllBranches()");
 	growAllBranches();
+	time.end();
 }
 
 void Skeletonization::runStep3_UpdateRadius()
 {
-	cout << "runStep3_UpdateRadius" << endl;
+	Profiler::Scope profile("runStep3");
+	LOG_DEBUG << "runStep3_UpdateRadius";
 
+  time.start("mergeNearEndsGroup()");
   mergeNearEndsGroup();
+  time.end();
+
+  time.start("cleanPointsNearBranches()");
   cleanPointsNearBranches();
+  time.end();
+
+  time.start("labelFixOriginal()");
   labelFixOriginal();
+  time.end();
+
+  time.start("rememberVirtualEnds()");
   rememberVirtualEnds();
+  time.end();
+
+  time.start("increaseRadius()");
   increaseRadius();
+  time.end();
 }
 
 Skeletonization::Skeletonization(RichParameterSet* _para)
 {
-	cout << "WLP constructed!!" << endl;
+	LOG_TRACE << "WLP constructed!!";
 	para = _para;
+	data = NULL;
 	samples = NULL;
 	original = NULL;
 	skeleton = NULL;
 	nTimeIterated = 0;
 	error_x = 0.0;
+	iterate_error = 0.0;
+	iterate_percentile_error = 0.0;
 	iterate_time_in_one_stage = 0;
+	is_warm_started = false;
+	is_skeleton_locked = false;
+	checkpoint_interval = 0;
 }
 
 Skeletonization::~Skeletonization(void)
 {
-	cout << "Skeletonization destroy!! " << endl; 
+	LOG_TRACE << "Skeletonization destroy!! "; 
 }
 
 void Skeletonization::clear()
@@ -219,6 +1015,11 @@ void Skeletonization::clear()
 void Skeletonization::setFirstIterate()
 {
 	nTimeIterated = 0;
+	is_warm_started = false;
+	stage_iterations.clear();
+	stage_radii.clear();
+	still_iterations.clear();
+	accelerator.restart();
 }
 
 void Skeletonization::setInput(DataMgr* pData)
@@ -231,11 +1032,12 @@ void Skeletonization::setInput(DataMgr* pData)
 
 		if(_samples == NULL || _original == NULL)
 		{
-			cout << "ERROR: Skeletonization::setInput == NULL!!" << endl;
+			LOG_ERROR << "ERROR: Skeletonization::setInput == NULL!!";
 			return;
 		}
 
 		error_x = 0.0;
+		data = pData;
 		samples = _samples;
 		original = _original;
 		skeleton = _skeleton;
@@ -244,7 +1046,7 @@ void Skeletonization::setInput(DataMgr* pData)
 	}
 	else
 	{
-		cout << "ERROR: Skeletonization::setInput: empty!!" << endl;
+		LOG_ERROR << "ERROR: Skeletonization::setInput: empty!!";
 		return;
 	}
 }
@@ -287,6 +1089,21 @@ void Skeletonization::initVertexes()
 
 	repulsion_weight_sum.assign(samples->vn, 0);
 	average_weight_sum.assign(samples->vn, 0);
+
+	double freeze_epsilon = para->getDouble("Freeze Move Epsilon");
+	int freeze_iterations = para->getDouble("Freeze Still Iterations");
+	if (still_iterations.size() != samples->vn)
+	{
+		still_iterations.assign(samples->vn, 0);
+	}
+	is_sample_frozen.assign(samples->vn, false);
+	if (freeze_epsilon > 0)
+	{
+		for (int i = 0; i < samples->vn; i++)
+		{
+			is_sample_frozen[i] = still_iterations[i] >= freeze_iterations;
+		}
+	}
 }
 
 
@@ -302,12 +1119,12 @@ void Skeletonization::computeAverageTerm(CMesh* samples, CMesh* original)
 	double radius2 = radius * radius;
 	double iradius16 = -para->getDouble("H Gaussian Para")/radius2;
 
-	cout << "Original Size:" << samples->vert[0].original_neighbors.size() << endl;
+	LOG_TRACE << "Original Size:" << samples->vert[0].original_neighbors.size();
 	for(int i = 0; i < samples->vert.size(); i++)
 	{
 		CVertex& v = samples->vert[i];
 
-		if (v.is_fixed_sample) //Here is different from WLOP
+		if (v.is_fixed_sample || is_sample_frozen[i]) //Here is different from WLOP
 		{
 			average_weight_sum[i] = 0.;
 			continue;
@@ -349,19 +1166,87 @@ void Skeletonization::computeAverageTerm(CMesh* samples, CMesh* original)
 }
 
 
+// repulsion of one sample, exact for single points and approximated for
+// far clusters of the octree which are treated as one heavy point
+class RepulsionAccumulator
+{
+public:
+	RepulsionAccumulator(CVertex& _v, double _radius, double _iradius16, double _power)
+		:v(_v), radius(_radius), iradius16(_iradius16), power(_power), sum(0, 0, 0), weight_sum(0){}
+
+	void operator()(CVertex& t)
+	{
+		if (&t != &v)
+		{
+			add(t.P(), 1);
+		}
+	}
+
+	void operator()(const Point3f& center, int count)
+	{
+		add(center, count);
+	}
+
+	void add(const Point3f& q, int count)
+	{
+		Point3f diff = v.P() - q;
+
+		double dist2  = diff.SquaredNorm();
+		double len = sqrt(dist2);
+		if(len <= 0.001 * radius) len = radius*0.001;
+
+		double w = exp(dist2*iradius16);
+		double rep = count * w * pow(1.0 / len, power);
+
+		sum += diff * rep;
+		weight_sum += rep;
+	}
+
+	CVertex& v;
+	double radius, iradius16, power;
+	Point3f sum;
+	double weight_sum;
+};
+
 void Skeletonization::computeRepulsionTerm(CMesh* samples)
 {
 	double repulsion_power = para->getDouble("Repulsion Power");
 	double radius = para->getDouble("CGrid Radius"); 
+	double theta = para->getDouble("Repulsion Opening Angle");
 
 	double radius2 = radius * radius;
 	double iradius16 = -para->getDouble("H Gaussian Para")/radius2;
 
+	if (theta > 0)
+	{
+		COctree octree;
+		octree.init(samples->vert);
+
+		#pragma omp parallel for schedule(dynamic, 64)
+		for(int i = 0; i < samples->vert.size(); i++)
+		{
+			CVertex& v = samples->vert[i];
+
+			if (v.is_fixed_sample || v.is_skel_ignore || is_sample_frozen[i])
+			{
+				repulsion_weight_sum[i] = 0.;
+				continue;
+			}
+
+			RepulsionAccumulator acc(v, radius, iradius16, repulsion_power);
+			octree.query(v.P(), radius, theta, acc, acc);
+
+			repulsion[i] += acc.sum;
+			repulsion_weight_sum[i] += acc.weight_sum;
+		}
+		return;
+	}
+
 	for(int i = 0; i < samples->vert.size(); i++)
 	{
 		CVertex& v = samples->vert[i];
 
-		if (v.is_fixed_sample || v.is_skel_ignore)//Here is different from WLOP
+		if (v.is_fixed_sample || v.is_skel_ignore || is_sample_frozen[i])//Here is different from WLOP
 		{
 			repulsion_weight_sum[i] = 0.;
 			continue;
@@ -451,6 +1336,7 @@ void Skeletonization::computeDensity(bool isOriginal, double radius)
 
 double Skeletonization::wlopIterate()
 {
+	Profiler::Scope profile("wlopIterate");
 	Timer time;
 
 	initVertexes();
@@ -460,34 +1346,45 @@ double Skeletonization::wlopIterate()
 		para->getDouble("CGrid Radius"), samples->bbox);
 	GlobalFun::computeEigenWithTheta(samples, para->getDouble("CGrid Radius") / sqrt(para->getDouble("H Gaussian Para")));
 	time.end();
+	metrics.neighbor_seconds = time.getTimeUsed();
 
 	if (nTimeIterated == 0) 
 	{
 		time.start("Original Initial");
-		GlobalFun::computeBallNeighbors(original, NULL, 
-			para->getDouble("CGrid Radius"), original->bbox);
-
-		original_density.assign(original->vn, 0);
 		if (para->getBool("Need Compute Density"))
 		{
-			computeDensity(true, para->getDouble("CGrid Radius"));
+			original_density = data->getOriginalDensity(para->getDouble("CGrid Radius"), 
+				para->getDouble("H Gaussian Para"), para->getBool("Persist Original Density"));
+		}
+		else
+		{
+			original_density.assign(original->vn, 0);
 		}
 		time.end();
+		metrics.neighbor_seconds += time.getTimeUsed();
 	}
 
 	time.start("Sample Original neighbor");
 	GlobalFun::computeBallNeighbors(samples, original, 
 		para->getDouble("CGrid Radius"), box);
 	time.end();
+	metrics.neighbor_seconds += time.getTimeUsed();
+	if (metrics_callback)
+	{
+		collectNeighborMetrics();
+	}
 
 	time.start("computeAverageTerm");
 	computeAverageTerm(samples, original);
 	time.end();
+	metrics.average_seconds = time.getTimeUsed();
 
 	time.start("computeRepulsionTerm");
 	computeRepulsionTerm(samples);
 	time.end();
+	metrics.repulsion_seconds = time.getTimeUsed();
 
+	time.start("moveSamples");
 	double min_sigma = GlobalFun::getDoubleMAXIMUM();
 	double max_sigma = -1;
 	for (int i = 0; i < samples->vn; i++)
@@ -510,6 +1407,13 @@ double Skeletonization::wlopIterate()
 	Point3f c;
 	int moving_num = 0;
 	double max_error = 0;
+	double freeze_epsilon = para->getDouble("Freeze Move Epsilon");
+	sample_movement.clear();
+
+	accelerator.setup(para->getInt("Acceleration Mode"), 
+		para->getDouble("Acceleration Momentum"), para->getDouble("Anderson Depth"));
+	vector<int> accelerate_index;
+	vector<Point3f> accelerate_old, accelerate_new;
 
 	for(int i = 0; i < samples->vert.size(); i++)
 	{
@@ -518,6 +1422,11 @@ double Skeletonization::wlopIterate()
 		{
 			continue;
 		}
+		if (is_sample_frozen[i])
+		{
+			sample_movement.push_back(0);
+			continue;
+		}
 		c = v.P();
 
 		double mu = (mu_length / sigma_length) * (v.eigen_confidence - min_sigma) + mu_min;
@@ -539,12 +1448,62 @@ double Skeletonization::wlopIterate()
 			double move_error = sqrt(diff.SquaredNorm());
 
 			error_x += move_error; 
+			sample_movement.push_back(move_error);
+
+			if (move_error < freeze_epsilon)
+			{
+				still_iterations[i]++;
+			}
+			else
+			{
+				still_iterations[i] = 0;
+			}
+
+			if (accelerator.isEnabled())
+			{
+				accelerate_index.push_back(i);
+				accelerate_old.push_back(c);
+				accelerate_new.push_back(v.P());
+			}
 		}
 	}
-	error_x = error_x / moving_num;
+	error_x = moving_num > 0 ? error_x / moving_num : 0;
+	time.end();
+	metrics.move_seconds = time.getTimeUsed();
+
+	// the error above is the plain fixed point residual, the accelerated step
+	// only changes where the samples go next
+	if (accelerator.isEnabled())
+	{
+		time.start("accelerate");
+		accelerator.accelerate(accelerate_index, accelerate_old, accelerate_new);
+		for (int k = 0; k < accelerate_index.size(); k++)
+		{
+			samples->vert[accelerate_index[k]].P() = accelerate_new[k];
+		}
+		time.end();
+		metrics.move_seconds += time.getTimeUsed();
+	}
+
+	iterate_percentile_error = 0;
+	double percentile = para->getDouble("Stop Error Percentile");
+	if (percentile > 0 && !sample_movement.empty())
+	{
+		int k = (sample_movement.size() - 1) * MyMin(percentile, 100.) / 100.;
+		nth_element(sample_movement.begin(), sample_movement.begin() + k, sample_movement.end());
+		iterate_percentile_error = sample_movement[k];
+	}
 
 	para->setValue("Current Movement Error", DoubleValue(error_x));
-	cout << "****finished compute Skeletonization error:	" << error_x << endl;
+	if (percentile > 0)
+	{
+		LOG_DEBUG << "****finished compute Skeletonization error:	" << error_x
+		          << "	" << percentile << "th percentile:	" << iterate_percentile_error;
+	}
+	else
+	{
+		LOG_DEBUG << "****finished compute Skeletonization error:	" << error_x;
+	}
 	return error_x;
 }
 
@@ -719,11 +1678,11 @@ void Skeletonization::searchNewBranches()
 					new_branch.branch_id = skeleton->branches.size();
 					if (i==0)
 					{
-						new_branch.rememberVirtualHead();
+						new_branch.rememberVirtualHead(para);
 					}
 					else if (i == new_branch.getSize()-1)
 					{
-						new_branch.rememberVirtualTail();
+						new_branch.rememberVirtualTail(para);
 					}
 				}
 				else
@@ -753,13 +1712,13 @@ Branch Skeletonization::searchOneBranchFromIndex(int begin_idx)
 	CVertex begin_v = samples->vert[begin_idx];
 	if (begin_v.is_skel_branch)
 	{
-		cout << "why start from branched points ?!" << endl;
+		LOG_DEBUG << "why start from branched points ?!";
 		return new_branch;
 	}
 
 	if (begin_v.neighbors.size() < 1)
 	{
-		cout << "empty neighbor of begin_v " << endl;
+		LOG_DEBUG << "empty neighbor of begin_v ";
 		return new_branch;
 	}
 
@@ -915,7 +1874,7 @@ void Skeletonization::growVirtualTailUntilStop(Branch& branch)
 		CVertex& v = samples->vert[tail.m_index];
 		if (v.neighbors.empty())
 		{
-			cout << "empty neighbor????" << endl;
+			LOG_DEBUG << "empty neighbor????";
 			return;
 		}
 
@@ -994,7 +1953,7 @@ void Skeletonization::growVirtualTailUntilStop(Branch& branch)
 					branch.pushBackCVertex(near_v);
 					is_tail_growing = true;
 
-					branch.rememberVirtualTail();
+					branch.rememberVirtualTail(para);
 				}
 			}
 			else
@@ -1065,7 +2024,7 @@ void Skeletonization::mergeNearEndsGroup()
 		}
 		else
 		{
-      cout << "have danger" << endl;
+      LOG_DEBUG << "have danger";
 			//visited_pts.push_back(head);
 			//visited_pts.push_back(tail);
 		}
@@ -1553,7 +2512,7 @@ double Skeletonization::getMaxAngleOfTwoPair(vector<Point3f>& dir0, vector<Point
      new_branch.back_up_head = branch0.back_up_tail;
      new_branch.back_up_tail = branch1.back_up_tail;
      
-     cout << "H0_T0 H0_T0" << endl << endl;
+     LOG_TRACE << "H0_T0 H0_T0";
      break;}
 
    case H0_T1: {
@@ -1572,7 +2531,7 @@ double Skeletonization::getMaxAngleOfTwoPair(vector<Point3f>& dir0, vector<Point
      new_branch.back_up_head = branch0.back_up_tail;
      new_branch.back_up_tail = branch1.back_up_head;
 
-     cout << "H0_T1 H0_T1" << endl << endl;
+     LOG_TRACE << "H0_T1 H0_T1";
      break;}
 
    case T0_H1:
@@ -1589,7 +2548,7 @@ double Skeletonization::getMaxAngleOfTwoPair(vector<Point3f>& dir0, vector<Point
      new_branch.back_up_head = branch0.back_up_head;
      new_branch.back_up_tail = branch1.back_up_tail;
 
-     cout << "T0_H1 T0_H1" << endl << endl;
+     LOG_TRACE << "T0_H1 T0_H1";
      break;
 
    case T0_T1: {
@@ -1607,7 +2566,7 @@ double Skeletonization::getMaxAngleOfTwoPair(vector<Point3f>& dir0, vector<Point
      new_branch.back_up_head = branch0.back_up_head;
      new_branch.back_up_tail = branch1.back_up_head;
 
-     cout << "T0_T1 T0_T1" << endl << endl;
+     LOG_TRACE << "T0_T1 T0_T1";
      break;}
    }
 
@@ -1694,6 +2653,12 @@ void Skeletonization::cleanPointsNearBranches()
 
 void Skeletonization::labelFixOriginal()
 {
+  if (para->getBool("Fuse Fix Original"))
+  {
+    labelFixOriginalFused();
+    return;
+  }
+
   int mode = para->getInt("Fix Original Mode");
   //double pca_para = para->getDouble("PCA Radius Para");
   double pca_para = 1.0;
@@ -1766,7 +2731,7 @@ void Skeletonization::labelFixOriginal()
     }
 
     GlobalFun::computeBallNeighbors(samples, original, 
-      para->getDouble("Local Density Radius") / sqrt(para->getDouble("H Gaussian Para")) * pca_para, original->bbox);
+      getLocalDensityRadius() / sqrt(para->getDouble("H Gaussian Para")) * pca_para, original->bbox);
 
     for (int i = 0; i < samples->vert.size(); i++)
     {
@@ -1855,13 +2820,155 @@ void Skeletonization::labelFixOriginal()
 
 }
 
+// "Local Density Radius" of fix mode 2, 0 stands for 0.8 * "CGrid Radius"
+double Skeletonization::getLocalDensityRadius()
+{
+  double local_radius = para->getDouble("Local Density Radius");
+  if (local_radius <= 0)
+  {
+    local_radius = para->getDouble("CGrid Radius") * 0.8;
+  }
+  return local_radius;
+}
+
+// Same labels as the list sweeps in labelFixOriginal, but every original looks
+// at the samples around it in a single traversal of the grids, testing both
+// radii at once. No neighbor lists are built, so the samples keep the
+// original_neighbors of the last WLOP step.
+void Skeletonization::labelFixOriginalFused()
+{
+  int mode = para->getInt("Fix Original Mode");
+  if (mode < 1 || mode > 5)
+  {
+    return;
+  }
+
+  if (mode == 5)
+  {
+    for (int i = 0; i < original->vert.size(); i++)
+    {
+      original->vert[i].is_fixed_original = false;
+    }
+    return;
+  }
+
+  double sqrt_h = sqrt(para->getDouble("H Gaussian Para"));
+  double radius = para->getDouble("CGrid Radius") / sqrt_h;
+  double local_radius = 0;
+  if (mode == 2)
+  {
+    local_radius = getLocalDensityRadius() / sqrt_h;
+  }
+
+  double cell_radius = radius > local_radius ? radius : local_radius;
+  if (cell_radius < 0.0001)
+  {
+    LOG_WARN << "too small grid!!";
+    return;
+  }
+
+  // both grids share the cell layout, so cell c of one sits on cell c of the other
+  CGrid sample_grid, original_grid;
+  sample_grid.init(samples->vert, original->bbox, cell_radius);
+  original_grid.init(original->vert, original->bbox, cell_radius);
+
+  double radius2 = radius * radius;
+  double local_radius2 = local_radius * local_radius;
+  CVertex* first_sample = samples->vert.data();
+  int xside = original_grid.xside;
+  int yside = original_grid.yside;
+  int zside = original_grid.zside;
+  int cell_num = xside * yside * zside;
+
+#pragma omp parallel for schedule(dynamic, 256)
+  for (int c = 0; c < cell_num; c++)
+  {
+    if (original_grid.isEmpty(c))
+    {
+      continue;
+    }
+
+    int x = c % xside;
+    int y = (c / xside) % yside;
+    int z = c / (xside * yside);
+
+    for (CGrid::iterator it = original_grid.startV(c); it != original_grid.endV(c); it++)
+    {
+      CVertex& t = *(*it);
+      bool near_free = false;
+      bool near_fixed = false;
+      bool near_fixed_local = false;
+      int last_sample = -1;
+
+      for (int dz = -1; dz <= 1; dz++)
+      {
+        if (z + dz < 0 || z + dz >= zside) continue;
+        for (int dy = -1; dy <= 1; dy++)
+        {
+          if (y + dy < 0 || y + dy >= yside) continue;
+          for (int dx = -1; dx <= 1; dx++)
+          {
+            if (x + dx < 0 || x + dx >= xside) continue;
+
+            int other = sample_grid.cell(x + dx, y + dy, z + dz);
+            for (CGrid::iterator s = sample_grid.startV(other); s != sample_grid.endV(other); s++)
+            {
+              CVertex& v = *(*s);
+              double dist2 = (t.P() - v.P()).SquaredNorm();
+              if (dist2 < radius2)
+              {
+                if (v.is_fixed_sample)
+                {
+                  near_fixed = true;
+                }
+                else
+                {
+                  near_free = true;
+                }
+
+                int idx = *s - first_sample;
+                if (idx > last_sample)
+                {
+                  last_sample = idx;
+                }
+              }
+
+              if (v.is_fixed_sample && dist2 < local_radius2)
+              {
+                near_fixed_local = true;
+              }
+            }
+          }
+        }
+      }
+
+      switch(mode)
+      {
+      case 1:
+        // the sweep in labelFixOriginal lets the last sample in index order win
+        t.is_fixed_original = last_sample < 0 || samples->vert[last_sample].is_fixed_sample;
+        break;
+      case 2:
+        t.is_fixed_original = !near_free || near_fixed_local;
+        break;
+      case 3:
+        t.is_fixed_original = !near_free;
+        break;
+      case 4:
+        t.is_fixed_original = near_fixed;
+        break;
+      }
+    }
+  }
+}
+
 void Skeletonization::rememberVirtualEnds()
 {
   for (int i = 0; i < skeleton->branches.size(); i++)
   {
     Branch& branch = skeleton->branches[i];
-    branch.rememberVirtualHead();
-    branch.rememberVirtualTail();
+    branch.rememberVirtualHead(para);
+    branch.rememberVirtualTail(para);
   }
 }
 
@@ -1878,7 +2985,7 @@ void Skeletonization::increaseRadius()
 
   current_radius *= (1 + speed);
   para->setValue("CGrid Radius", DoubleValue(current_radius));
-  std::cout << "------ Current Radius: " << current_radius << " ------" << std::endl;
+  LOG_INFO << "------ Current Radius: " << current_radius << " ------";
 
 
   // for KangXue: maybe you want to save the skel_radius for virtual points here
@@ -2051,7 +3158,7 @@ void Skeletonization::updateVirtualHeadFollowSamples(Branch& branch)
     samples->vert[head.m_index].setSample_MovingAndVirtual();
     head.P() = samples->vert[head.m_index].P();
 
-    branch.rememberVirtualHead();	
+    branch.rememberVirtualHead(para);	
   }
   else
   {
@@ -2392,7 +3499,7 @@ void Skeletonization::segmentOneCurve(Curve& c)
 
   if (c.size() < 5)
   {
-    cout << "too short for segment!!" << endl;
+    LOG_DEBUG << "too short for segment!!";
     return;
   }
 
@@ -2770,7 +3877,7 @@ void Skeletonization::reconnectSkeleton()
       std::copy(break_iter, end_iter, copy_curve.begin());
       break_curve.erase(break_iter+1, end_iter);
 
-      std::cerr << "ADDING A BRANCH" << std::endl;
+      LOG_DEBUG << "ADDING A BRANCH";
       skeleton->branches.push_back(copy_branch);
       skeleton->generateBranchSampleMap();	
     }
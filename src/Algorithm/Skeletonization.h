@@ -2,6 +2,8 @@
 #include "GlobalFunction.h"
 #include "PointCloudAlgorithm.h"
 #include "Skeleton.h"
+#include "FixedPointAccelerator.h"
+#include "IterationMetrics.h"
 
 
 class Skeletonization : public PointCloudAlgorithm
@@ -12,6 +14,17 @@ public:
 public:
 
   void run_full(DataMgr* pdata);
+  // sampling_method is the Sampler::METHOD the samples of data were taken with
+  void run_pyramid(DataMgr* pdata, int levels, double level_ratio, int sampling_method);
+  void seedFromSkeleton(DataMgr* pdata, Skeleton& coarse);
+  bool warmStartFromPrevious(DataMgr* pdata, const float* motion, int resume_stage);
+  void stitchSkeleton(Skeleton& parts, double merge_dist);
+  void setCheckpoint(const std::string& file, int interval);
+  bool saveCheckpoint(DataMgr* pdata, const std::string& file);
+  bool loadCheckpoint(DataMgr* pdata, const std::string& file);
+  // called with the metrics of every iteration, an empty callback turns
+  // their collection off
+  void setMetricsCallback(const IterationMetricsCallback& callback);
 	void run();
 	void setInput(DataMgr* pData);
 	RichParameterSet* getParameterSet(){ return para; }
@@ -21,6 +34,8 @@ public:
 	void setFirstIterate();
   int getIterateNum(){ return nTimeIterated; }
 	double getErrorX(){return error_x;}
+  const vector<int>& getStageIterations(){ return stage_iterations; }
+  const vector<double>& getStageRadii(){ return stage_radii; }
   
 private:
 	void runAutoWlopOneStep();
@@ -76,6 +91,8 @@ private:
   // do some clean up before increase radius
   void cleanPointsNearBranches();
   void labelFixOriginal();
+  void labelFixOriginalFused();
+  double getLocalDensityRadius();
   void rememberVirtualEnds();
 
   // increase radius
@@ -108,6 +125,8 @@ protected:
 private:
 	void input(CMesh* _samples, CMesh* _original);
 	void initVertexes();
+	void collectNeighborMetrics();
+	void collectSampleMetrics();
 
 	double wlopIterate();
 	void computeAverageTerm(CMesh* samples, CMesh* original);
@@ -119,6 +138,7 @@ private:
 	RichParameterSet* para;
 
 private:
+	DataMgr* data;
 	CMesh* samples;
 	CMesh* original;
 	Skeleton* skeleton;
@@ -137,9 +157,27 @@ private:
 	vector<double>  average_weight_sum;
 
   bool is_skeleton_locked;
+  bool is_warm_started; // seeded from a coarser skeleton, keep "Initial Radius"
 
 private:
 	double iterate_error;
+	double iterate_percentile_error; // "Stop Error Percentile" of the sample movements
 	int iterate_time_in_one_stage;
+	vector<int> stage_iterations;
+	vector<double> stage_radii; // "CGrid Radius" every stage converged at
+
+	// per-sample convergence, samples that moved less than "Freeze Move Epsilon"
+	// for "Freeze Still Iterations" iterations are frozen until the radius grows
+	vector<int> still_iterations;
+	vector<bool> is_sample_frozen;
+	vector<double> sample_movement;
+
+	FixedPointAccelerator accelerator;
+
+	std::string checkpoint_file;
+	int checkpoint_interval; // iterations between checkpoints, 0 writes none
+
+	IterationMetricsCallback metrics_callback;
+	IterationMetrics metrics; // of the running iteration
   Timer time;
 };
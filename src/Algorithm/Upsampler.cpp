@@ -1,12 +1,14 @@
 #include "Algorithm/Upsampler.h"
 #include <cassert>
 
-vector<double> Upsampler::proj_dist;
-vector<double> Upsampler::proj_weight;
+thread_local vector<double> Upsampler::proj_dist;
+thread_local vector<double> Upsampler::proj_weight;
 
-vector<Point3f> Upsampler::sum_N;
-vector<Point3f> Upsampler::sum_Gw;
-vector<Point3f> Upsampler::sum_Gf;
+thread_local vector<Point3f> Upsampler::sum_N;
+thread_local vector<Point3f> Upsampler::sum_Gw;
+thread_local vector<Point3f> Upsampler::sum_Gf;
+
+thread_local double Upsampler::feature_sigma = 0;
 
 
 Upsampler::Upsampler(RichParameterSet* _para)
@@ -32,7 +34,7 @@ void Upsampler::setInput(DataMgr* pData)
 	}
 	else
 	{
-		cout << "ERROR: Upsampler:: setInput: empty!!" << endl;
+		LOG_ERROR << "ERROR: Upsampler:: setInput: empty!!";
 		return;
 	}
 }
@@ -41,20 +43,21 @@ void Upsampler::run()
 {
 	if(samples == NULL )
 	{
-		cout << "ERROR: Upsampler::run() mesh == NULL || original == NULL";
+		LOG_ERROR << "ERROR: Upsampler::run() mesh == NULL || original == NULL";
 		return;
 	}
+	feature_sigma = para->getDouble("Feature Sigma");
 
 	if (para->getBool("Run Projection"))
 	{
-		cout << "projection" <<endl;
+		LOG_DEBUG << "projection";
 		optimizeProjection();
 		return;
 	}
 
 	sigma = para->getDouble("Feature Sigma");
 	G_value = para->getDouble("Edge Parameter");
-	cout << "Edge Parameter: " << G_value << endl;
+	LOG_DEBUG << "Edge Parameter: " << G_value;
 
 	if(b_first)
 	{
@@ -107,7 +110,7 @@ void Upsampler::input(CMesh* _mesh)
 {
 	if(_mesh == NULL)
 	{
-		cout << "ERROR:  Upsampler::setInput mesh == NULL!!" << endl;
+		LOG_ERROR << "ERROR:  Upsampler::setInput mesh == NULL!!";
 		system("Pause");
 		return;
 	}
@@ -278,13 +281,13 @@ double Upsampler::getPredictThresholdFirstTime()
 
 	if(samples == NULL )
 	{
-		cout << "ERROR: Upsampler::run() mesh == NULL || original == NULL";
+		LOG_ERROR << "ERROR: Upsampler::run() mesh == NULL || original == NULL";
 		return -1;
 	}
 
 	sigma = para->getDouble("Feature Sigma");
 	G_value = para->getDouble("Edge Parameter");
-	cout << "Edge Parameter: " << G_value << endl;
+	LOG_DEBUG << "Edge Parameter: " << G_value;
 
 	if(b_first)
 	{
@@ -337,7 +340,7 @@ void Upsampler::insertPointsByThreshold()
 
 		double dist_threshold = para->getDouble("Dist Threshold");
 
-		cout << "threshold: " << dist_threshold << endl;
+		LOG_DEBUG << "threshold: " << dist_threshold;
 
 		samples->vn = samples->vert.size();
 
@@ -361,7 +364,7 @@ void Upsampler::insertPointsByThreshold()
 			if(bestDist < dist_threshold)
 			{
 				if(i < print_threshold_num)
-					cout << bestDist << endl;
+					LOG_TRACE << bestDist;
 
 				is_abandon_by_threshold[v.m_index] = true;
 				continue;
@@ -411,10 +414,10 @@ void Upsampler::insertPointsByThreshold()
 			break;
 		else
 		{
-			cout << "current size: " << samples->vert.size() << endl;
-			cout << "add point: " << samples->vert.size() - oldSize << endl;
+			LOG_INFO << "current size: " << samples->vert.size();
+			LOG_INFO << "add point: " << samples->vert.size() - oldSize;
 			oldSize = samples->vert.size();
-			cout << "abandent : " << abandonCounter << endl << endl; 
+			LOG_INFO << "abandent : " << abandonCounter; 
 		}
 
 	}
@@ -423,10 +426,10 @@ void Upsampler::insertPointsByThreshold()
 
 	if (addCounter > max_add_number)
 	{
-		cout << "exeed max add number" << endl;
+		LOG_WARN << "exeed max add number";
 	}
   para->setValue("Dist Threshold", DoubleValue(getPredictThreshold()));
-  cout << "getPredictThreshold" << getPredictThreshold() << endl;
+  LOG_DEBUG << "getPredictThreshold" << getPredictThreshold();
 
 	computeEigenVerctorForRendering();
 }
@@ -441,16 +444,16 @@ void Upsampler::recomputeAllNeighbors()
 	double grid_radius = para->getDouble("CGrid Radius");
 	radius = para->getDouble("CGrid Radius");
 
-	cout << "recomputeAllNeighbors" << endl;
+	LOG_DEBUG << "recomputeAllNeighbors";
 
 	initVertexes();
 
-	cout << "radius: " << grid_radius << endl;
+	LOG_DEBUG << "radius: " << grid_radius;
 
 	GlobalFun::computeBallNeighbors(samples, NULL, 
 		para->getDouble("CGrid Radius"), samples->bbox);
 
-	cout << "recomputeAllNeighbors end "<< endl;
+	LOG_DEBUG << "recomputeAllNeighbors end ";
 }
 
 
@@ -582,7 +585,7 @@ void Upsampler::self_optimize_upsamples_global(CGrid::iterator start, CGrid::ite
 	double iradius16 = -4/radius2;  
 	const double PI = 3.1415926;
 	double delta = 2.0;
-	double sigma = global_paraMgr.upsampling.getDouble("Feature Sigma");
+	double sigma = feature_sigma;
 
 	for(CGrid::iterator dest = start; dest != end; dest++) {
 		CVertex &v = *(*dest);
@@ -616,7 +619,7 @@ void Upsampler::other_optimize_upsamples_global(CGrid::iterator starta, CGrid::i
 	double iradius16 = -4/radius2;  
 	const double PI = 3.1415926;
 	double delta = 2.0;
-	double sigma = global_paraMgr.upsampling.getDouble("Feature Sigma");
+	double sigma = feature_sigma;
 
 	for(CGrid::iterator dest = starta; dest != enda; dest++) {
 		CVertex &v = *(*dest);
@@ -656,7 +659,7 @@ void Upsampler::self_optimize_normals(CGrid::iterator start, CGrid::iterator end
 	double iradius16 = -4/radius2;  
 	const double PI = 3.1415926;
 	double delta = 2.0;
-	double sigma = global_paraMgr.upsampling.getDouble("Feature Sigma");
+	double sigma = feature_sigma;
 
 	for(CGrid::iterator dest = start; dest != end; dest++) {
 		CVertex &v = *(*dest);
@@ -690,7 +693,7 @@ void Upsampler::other_optimize_normals(CGrid::iterator starta, CGrid::iterator e
 	double iradius16 = -4/radius2;  
 	const double PI = 3.1415926;
 	double delta = 2.0;
-	double sigma = global_paraMgr.upsampling.getDouble("Feature Sigma");
+	double sigma = feature_sigma;
 
 	for(CGrid::iterator dest = starta; dest != enda; dest++) {
 		CVertex &v = *(*dest);
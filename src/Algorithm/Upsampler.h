@@ -84,11 +84,15 @@ private:
 	inline void static updateVT_proj_normal(CVertex& v, CVertex& t, double weight, double radius);
 
 private:
-	static vector<double> proj_dist;
-	static vector<double> proj_weight;
+	// scratch of the static grid callbacks, one copy per thread so that
+	// upsamplers in different threads do not share it
+	static thread_local vector<double> proj_dist;
+	static thread_local vector<double> proj_weight;
 
-	static vector<Point3f> sum_N;
-	static vector<Point3f> sum_Gw;
-	static vector<Point3f> sum_Gf;
+	static thread_local vector<Point3f> sum_N;
+	static thread_local vector<Point3f> sum_Gw;
+	static thread_local vector<Point3f> sum_Gf;
+
+	static thread_local double feature_sigma;
 
 };
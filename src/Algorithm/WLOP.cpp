@@ -3,8 +3,9 @@
 
 WLOP::WLOP(RichParameterSet* _para)
 {
-	cout << "WLP constructed!!" << endl;
+	LOG_TRACE << "WLP constructed!!";
 	para = _para;
+	data = NULL;
 	samples = NULL;
 	original = NULL;
 	nTimeIterated = 0;
@@ -13,7 +14,7 @@ WLOP::WLOP(RichParameterSet* _para)
 
 WLOP::~WLOP(void)
 {
-	cout << "WLop destroy!! " << endl; 
+	LOG_TRACE << "WLop destroy!! "; 
 }
 
 void WLOP::clear()
@@ -36,11 +37,12 @@ void WLOP::setInput(DataMgr* pData)
 
 		if(_samples == NULL || _original == NULL)
 		{
-			cout << "ERROR: WLOP::setInput == NULL!!" << endl;
+			LOG_ERROR << "ERROR: WLOP::setInput == NULL!!";
 			return;
 		}
 
 		error_x = 0.0;
+		data = pData;
 		samples = _samples;
 		original = _original;
 
@@ -48,7 +50,7 @@ void WLOP::setInput(DataMgr* pData)
 	}
 	else
 	{
-		cout << "ERROR: WLOP::setInput: empty!!" << endl;
+		LOG_ERROR << "ERROR: WLOP::setInput: empty!!";
 		return;
 	}
 }
@@ -104,7 +106,7 @@ void WLOP::run()
 {
 	if (para->getBool("Run Anisotropic LOP"))
 	{
-		cout << "Run Anisotropic LOP" << endl;
+		LOG_INFO << "Run Anisotropic LOP";
 	}
 	//int nTimes = para->getDouble("Num Of Iterate Time");
 	for(int i = 0; i < 1; i++)
@@ -112,9 +114,9 @@ void WLOP::run()
 		iterate();
 		
 		nTimeIterated ++;
-		cout << "Iterated: " << nTimeIterated << endl;
+		LOG_DEBUG << "Iterated: " << nTimeIterated;
 	}
-	cout << "**************iterate Number: " << nTimeIterated << endl;
+	LOG_DEBUG << "**************iterate Number: " << nTimeIterated;
 }
 
 void WLOP::computeAverageTerm(CMesh* samples, CMesh* original)
@@ -126,7 +128,7 @@ void WLOP::computeAverageTerm(CMesh* samples, CMesh* original)
 	double radius2 = radius * radius;
 	double iradius16 = -para->getDouble("H Gaussian Para")/radius2;
 
-	cout << "Original Size:" << samples->vert[0].original_neighbors.size() << endl;
+	LOG_TRACE << "Original Size:" << samples->vert[0].original_neighbors.size();
 	for(int i = 0; i < samples->vert.size(); i++)
 	{
 		CVertex& v = samples->vert[i];
@@ -180,7 +182,7 @@ void WLOP::computeRepulsionTerm(CMesh* samples)
 	double radius2 = radius * radius;
 	double iradius16 = -para->getDouble("H Gaussian Para")/radius2;
 
-	cout << endl<< endl<< "Sample Neighbor Size:" << samples->vert[0].neighbors.size() << endl<< endl;
+	LOG_TRACE << "Sample Neighbor Size:" << samples->vert[0].neighbors.size();
 	for(int i = 0; i < samples->vert.size(); i++)
 	{
 		CVertex& v = samples->vert[i];
@@ -292,15 +294,9 @@ double WLOP::iterate()
 		if (para->getBool("Need Compute Density"))
 		{
 			double local_density_para = 0.95;
-			time.start("Original Original Neighbor Tree");
-			GlobalFun::computeBallNeighbors(original, NULL, 
-				para->getDouble("CGrid Radius") * local_density_para, original->bbox);
-			time.end();
-
 			time.start("Compute Original Density");
-			original_density.assign(original->vn, 0);
-
-			computeDensity(true, para->getDouble("CGrid Radius") * local_density_para);
+			original_density = data->getOriginalDensity(para->getDouble("CGrid Radius") * local_density_para, 
+				para->getDouble("H Gaussian Para"), para->getBool("Persist Original Density"));
 			time.end();
 		}
 		
@@ -355,7 +351,7 @@ double WLOP::iterate()
 	error_x = error_x / samples->vn;
 
 	para->setValue("Current Movement Error", DoubleValue(error_x));
-	cout << "****finished compute WLOP error:	" << error_x << endl;
+	LOG_DEBUG << "****finished compute WLOP error:	" << error_x;
 
 	if (para->getBool("Need Compute PCA"))
 	{
@@ -45,6 +45,7 @@ private:
 	RichParameterSet* para;
 
 private:
+	DataMgr* data;
 	CMesh* samples;
 	CMesh* original;
 
@@ -28,6 +28,7 @@
 #include <vcg/math/linear.h>
 #include <vcg/math/lin_algebra.h>
 #include <vcg/math/disjoint_set.h>
+#include "Random.h"
 #include <vcg/space/box3.h>
 #include <vcg/space/point3.h>
 #include <vcg/space/index/octree.h>
@@ -276,7 +277,7 @@ namespace vcg
 			typename std::vector< Plane >::iterator iCurrentPlane, iSonPlane;
 
 			MSTNode *mst_root;
-			int r_index = (root_index!=-1)? root_index : rand()*vertex_count/RAND_MAX;
+			int r_index = (root_index!=-1)? root_index : Random::local().below(vertex_count);
 			mst_root = &MST[ r_index ];
 			mst_root->parent = mst_root; //the parent of the root is the root itself
 
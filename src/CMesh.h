@@ -13,8 +13,10 @@
 
 #include <vcg/space/point3.h>
 
-#include <cstdlib> //for rand()
-#include <ctime> //for time()
+#include <cstdlib>
+#include <ctime>
+
+#include "Random.h"
 
 #include <vector>
 using std::vector;
@@ -153,10 +155,11 @@ public:
 
 	void recompute_m_render()
 	{
-		srand(time(NULL));
-		int x = rand()%1000;
-		int y = rand()%1000;
-		int z = rand()%1000;
+		// keyed by the index, the same in any thread
+		Random::Generator random = Random::stream(m_index);
+		int x = random.below(1000);
+		int y = random.below(1000);
+		int z = random.below(1000);
 
 		Point3f normal = N();
 		normal.Normalize();
@@ -0,0 +1,250 @@
+#include "ComponentSkeleton.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <omp.h>
+using namespace std;
+using namespace vcg;
+
+namespace ComponentSkeleton {
+
+// 21 bits per axis
+static const int KEY_BITS = 21;
+static const long long KEY_MAX = (1 << KEY_BITS) - 1;
+
+static inline unsigned long long cellKey(long long x, long long y, long long z) {
+  return ((unsigned long long)x << (2 * KEY_BITS)) | ((unsigned long long)y << KEY_BITS) |
+         (unsigned long long)z;
+}
+
+static int findRoot(vector<int> &parent, int i) {
+  while(parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+// true if some point of cell a is closer than the gap to some point of cell b
+static bool touches(vector<CVertex> &vert, const vector<pair<unsigned long long, int> > &keys,
+                    int a_begin, int a_end, int b_begin, int b_end, double gap2) {
+  for(int i = a_begin; i < a_end; i++) {
+    const Point3f &p = vert[keys[i].second].P();
+    for(int j = b_begin; j < b_end; j++)
+      if((p - vert[keys[j].second].P()).SquaredNorm() < gap2)
+        return true;
+  }
+  return false;
+}
+
+// The points go into cells with a diagonal of one gap, so all points of a cell
+// are connected and the union-find runs over cells. Two cells are connected if
+// any of their points are; cells up to two apart can be, and these tests run
+// in parallel before the sequential union.
+int label(std::vector<CVertex> &vert, double gap, std::vector<int> &labels) {
+  long long n = vert.size();
+  labels.assign(n, -1);
+  if(n == 0 || gap <= 0)
+    return 0;
+
+  Box3f box;
+  for(long long i = 0; i < n; i++)
+    box.Add(vert[i].P());
+  double size = gap / sqrt(3.0);
+  Point3f ext = box.max - box.min;
+  double max_ext = max(ext[0], max(ext[1], ext[2]));
+  if(max_ext / size > KEY_MAX) {
+    // cells larger than the gap may join points that are a bit too far apart
+    size = max_ext / KEY_MAX;
+    LOG_WARN << "Component gap is too small for the extent, using " << size * sqrt(3.0);
+  }
+
+  vector<pair<unsigned long long, int> > keys(n);
+#pragma omp parallel for schedule(static)
+  for(long long i = 0; i < n; i++) {
+    long long c[3];
+    for(int k = 0; k < 3; k++) {
+      c[k] = (long long)floor((vert[i].P()[k] - box.min[k]) / size);
+      c[k] = c[k] < 0 ? 0 : (c[k] > KEY_MAX ? KEY_MAX : c[k]);
+    }
+    keys[i] = make_pair(cellKey(c[0], c[1], c[2]), (int)i);
+  }
+  sort(keys.begin(), keys.end());
+
+  vector<int> starts;
+  vector<unsigned long long> cell_keys;
+  for(long long i = 0; i < n; i++)
+    if(i == 0 || keys[i].first != keys[i-1].first) {
+      starts.push_back(i);
+      cell_keys.push_back(keys[i].first);
+    }
+  starts.push_back(n);
+  int cells = cell_keys.size();
+
+  // neighbor offsets with a key above the cell, whose nearest points can be
+  // closer than the gap: sum of (|d| - 1)^2 cell sizes below 3
+  vector<int> offsets;
+  for(int dz = -2; dz <= 2; dz++)
+    for(int dy = -2; dy <= 2; dy++)
+      for(int dx = -2; dx <= 2; dx++) {
+        int d[3] = { dx, dy, dz }, reach = 0;
+        for(int k = 0; k < 3; k++) {
+          int a = abs(d[k]) - 1;
+          reach += a > 0 ? a * a : 0;
+        }
+        bool above = dx > 0 || (dx == 0 && (dy > 0 || (dy == 0 && dz > 0)));
+        if(reach < 3 && above) {
+          offsets.push_back(dx);
+          offsets.push_back(dy);
+          offsets.push_back(dz);
+        }
+      }
+
+  vector<vector<int> > edges(cells);
+  double gap2 = gap * gap;
+#pragma omp parallel for schedule(dynamic, 256)
+  for(int c = 0; c < cells; c++) {
+    unsigned long long key = cell_keys[c];
+    long long x = (key >> (2 * KEY_BITS)) & KEY_MAX;
+    long long y = (key >> KEY_BITS) & KEY_MAX;
+    long long z = key & KEY_MAX;
+    for(size_t o = 0; o < offsets.size(); o += 3) {
+      long long nx = x + offsets[o], ny = y + offsets[o+1], nz = z + offsets[o+2];
+      if(nx < 0 || ny < 0 || nz < 0 || nx > KEY_MAX || ny > KEY_MAX || nz > KEY_MAX)
+        continue;
+      vector<unsigned long long>::iterator it =
+          lower_bound(cell_keys.begin(), cell_keys.end(), cellKey(nx, ny, nz));
+      if(it == cell_keys.end() || *it != cellKey(nx, ny, nz))
+        continue;
+      int d = it - cell_keys.begin();
+      if(touches(vert, keys, starts[c], starts[c+1], starts[d], starts[d+1], gap2))
+        edges[c].push_back(d);
+    }
+  }
+
+  vector<int> parent(cells);
+  for(int c = 0; c < cells; c++)
+    parent[c] = c;
+  for(int c = 0; c < cells; c++)
+    for(size_t e = 0; e < edges[c].size(); e++) {
+      int a = findRoot(parent, c), b = findRoot(parent, edges[c][e]);
+      if(a != b)
+        parent[max(a, b)] = min(a, b);
+    }
+
+  // number the components by decreasing point count
+  vector<int> root_size(cells, 0);
+  for(int c = 0; c < cells; c++)
+    root_size[findRoot(parent, c)] += starts[c+1] - starts[c];
+  vector<pair<int, int> > order;
+  for(int c = 0; c < cells; c++)
+    if(root_size[c] > 0)
+      order.push_back(make_pair(-root_size[c], c));
+  sort(order.begin(), order.end());
+  vector<int> component(cells, -1);
+  for(size_t k = 0; k < order.size(); k++)
+    component[order[k].second] = k;
+
+#pragma omp parallel for schedule(dynamic, 256)
+  for(int c = 0; c < cells; c++) {
+    int id = component[findRoot(parent, c)];
+    for(int i = starts[c]; i < starts[c+1]; i++)
+      labels[keys[i].second] = id;
+  }
+  return order.size();
+}
+
+int run(SkeletonContext &context, const Options &options) {
+  CMesh *original = context.getData()->getCurrentOriginal();
+  vector<int> labels;
+  int count = label(original->vert, options.gap, labels);
+
+  // coordinates and normals of every component that is large enough
+  vector<size_t> sizes(count, 0);
+  for(size_t i = 0; i < labels.size(); i++)
+    sizes[labels[i]]++;
+  while(count > 0 && sizes[count-1] < options.min_points)
+    count--;
+  LOG_INFO << "Found " << sizes.size() << " components, " << count << " with at least "
+           << options.min_points << " points";
+
+  vector<vector<float> > points(count), normals(count);
+  for(int c = 0; c < count; c++) {
+    points[c].reserve(3 * sizes[c]);
+    normals[c].reserve(3 * sizes[c]);
+  }
+  for(size_t i = 0; i < labels.size(); i++) {
+    int c = labels[i];
+    if(c >= count)
+      continue;
+    CVertex &v = original->vert[i];
+    for(int k = 0; k < 3; k++) {
+      points[c].push_back(v.P()[k]);
+      normals[c].push_back(v.N()[k]);
+    }
+  }
+  size_t total = original->vert.size();
+
+  ParameterMgr base(*context.getParameterMgr());
+  vector<Skeleton> skeletons(count);
+  int jobs = options.jobs > 0 ? options.jobs : omp_get_max_threads();
+  jobs = max(1, min(jobs, count));
+  int threads_per_job = max(1, omp_get_max_threads() / jobs);
+  atomic<int> next(0);
+  mutex print_mutex;
+
+  // the components are sorted by size, so the largest start first and the
+  // small ones fill the workers as they become free
+  auto worker = [&]() {
+    if(jobs > 1)
+      omp_set_num_threads(threads_per_job);
+    SkeletonContext local(base);
+    for(int c = next++; c < count; c = next++) {
+      size_t n = sizes[c];
+      try {
+        Random::restart(c);
+        local.resetParameters(base);
+        local.setOriginal(&points[c][0], n, 3 * sizeof(float), &normals[c][0], 3 * sizeof(float));
+        int want = options.sample_num > 0 ?
+                   (int)max(1.0, (double)options.sample_num * n / total) : 0;
+        local.sample(options.sampling_method, want, options.radius);
+        local.run(options.pyramid_levels, options.pyramid_ratio);
+        skeletons[c] = *local.getSkeleton();
+
+        lock_guard<mutex> lock(print_mutex);
+        LOG_INFO << "Component " << c + 1 << "/" << count << ": " << n << " points, "
+                 << skeletons[c].branches.size() << " branches";
+      } catch(const exception &e) {
+        lock_guard<mutex> lock(print_mutex);
+        LOG_ERROR << "Component " << c + 1 << "/" << count << " failed: " << e.what();
+      }
+      local.clear();
+    }
+  };
+
+  if(jobs == 1) {
+    worker();
+  } else {
+    vector<thread> pool;
+    for(int j = 0; j < jobs; j++)
+      pool.emplace_back(worker);
+    for(size_t j = 0; j < pool.size(); j++)
+      pool[j].join();
+  }
+
+  Skeleton *merged = context.getSkeleton();
+  merged->clear();
+  for(int c = 0; c < count; c++)
+    merged->branches.insert(merged->branches.end(), skeletons[c].branches.begin(),
+                            skeletons[c].branches.end());
+  merged->generateBranchSampleMap();
+  return count;
+}
+
+}
@@ -0,0 +1,40 @@
+#ifndef COMPONENT_SKELETON_H
+#define COMPONENT_SKELETON_H
+
+#include <string>
+#include <vector>
+#include "SkeletonContext.h"
+
+// Skeletonization of clouds holding several disjoint objects. The original is
+// split into its connected components (points closer than a gap are
+// connected) and every component is skeletonized on its own, with its own
+// initial radius from DataMgr::getInitRadiuse and its own radius schedule.
+// Components run one after the other, or with jobs > 1 concurrently on a
+// pool of contexts, the largest first; the skeletons are merged in component
+// order.
+namespace ComponentSkeleton {
+
+struct Options {
+  Options() : gap(0), min_points(50), sample_num(0), sampling_method(0), radius(0),
+              pyramid_levels(1), pyramid_ratio(4.0), jobs(1) {}
+
+  double gap;            // points closer than this are in one component
+  size_t min_points;     // smaller components are dropped as noise
+  int sample_num;        // samples over the whole cloud, <= 0 uses every point
+  int sampling_method;   // Sampler::METHOD
+  double radius;         // initial radius, <= 0 derives it for every component
+  int pyramid_levels;    // see SkeletonContext::run
+  double pyramid_ratio;
+  int jobs;              // components run at the same time, <= 0 uses all threads
+};
+
+// component label of every vertex, components numbered by decreasing size
+int label(std::vector<CVertex> &vert, double gap, std::vector<int> &labels);
+
+// Skeletonize the original held by the context; the merged skeleton is left
+// in the context. Returns the number of components skeletonized.
+int run(SkeletonContext &context, const Options &options);
+
+}
+
+#endif
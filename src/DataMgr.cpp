@@ -1,14 +1,28 @@
 #include "DataMgr.h"
 
-#include <pcl/point_cloud.h>
-#include <pcl/point_types.h>
-#include <pcl/io/pcd_io.h>
-#include <pcl/PCLPointCloud2.h>
+#include "PointIO.h"
+#include "Sampler.h"
 
+#include <algorithm>
+#include <cstring>
+#include <mutex>
 
-DataMgr::DataMgr(RichParameterSet* _para)
+// sample flags packed into one byte in the binary files
+enum SAMPLE_FLAG { FLAG_FIXED = 1, FLAG_BRANCH = 2, FLAG_VIRTUAL = 4, FLAG_IGNORE = 8 };
+
+static unsigned char packFlags(const CVertex& v)
+{
+  return (v.is_fixed_sample ? FLAG_FIXED : 0) | (v.is_skel_branch ? FLAG_BRANCH : 0) |
+         (v.is_skel_virtual ? FLAG_VIRTUAL : 0) | (v.is_skel_ignore ? FLAG_IGNORE : 0);
+}
+
+DataMgr::DataMgr(RichParameterSet* _para, ParameterMgr* _paraMgr)
 {
 	para = _para;
+	paraMgr = _paraMgr;
+	original_density_radius = -1;
+	original_density_h = -1;
+	original_density_hash = 0;
 }
 
 
@@ -23,6 +37,11 @@ void DataMgr::clearCMesh(CMesh& mesh)
 	mesh.vert.clear();
 	mesh.vn = 0;
 	mesh.bbox = Box3f();
+
+	if (&mesh == &original)
+	{
+		original_file_name.clear();
+	}
 }
 
 bool DataMgr::isSamplesEmpty()
@@ -41,122 +60,257 @@ bool DataMgr::isSkeletonEmpty()
   return skeleton.isEmpty();
 }
 
-inline float get_float(uint8_t* pt, const pcl::PCLPointField& f)
+void DataMgr::loadPCD(const std::string& filename, bool is_sample)
 {
-  return *(float*)&pt[f.offset];
-}
+  Profiler::Scope profile("loadPCD");
+  PointIO::MappedFile file;
+  PointIO::PCDHeader header;
+  std::string error;
+  if (!file.open(filename)) {
+    LOG_ERROR << "Could not open " << filename;
+    return;
+  }
+  if (!header.parse(file.data(), file.size(), error)) {
+    LOG_ERROR << filename << ": " << error;
+    return;
+  }
 
-inline double get_double(uint8_t* pt, const pcl::PCLPointField& f)
-{
-  return *(double*)&pt[f.offset];
-}
+  if (header.find("x") < 0 || header.find("y") < 0 || header.find("z") < 0) {
+    LOG_ERROR << "PCD must contains x,y,z fields. NO POINTS LOADED.";
+    return;
+  }
+  bool has_normal = header.find("normal_x") >= 0 && header.find("normal_y") >= 0
+                    && header.find("normal_z") >= 0;
 
-inline float get_field(uint8_t* pt, const pcl::PCLPointField& f)
-{
-  if (f.datatype == pcl::PCLPointField::PointFieldTypes::FLOAT32) {
-    return get_float(pt, f);
-  } else if (f.datatype == pcl::PCLPointField::PointFieldTypes::FLOAT64) {
-    return static_cast<float>(get_double(pt, f));
+  CMesh& mesh = is_sample ? samples : original;
+  clearCMesh(mesh);
+  curr_file_name = filename.c_str();
+  if (!is_sample) {
+    original_file_name = filename;
   }
-}
 
-void DataMgr::loadPCD(const std::string& filename, bool is_sample)
-{
-  pcl::PCLPointCloud2 cloud;
-  pcl::PCDReader in;
-  in.read(filename, cloud);
-
-  bool has_point = false;
-  bool has_normal = false;  
-  uint32_t findex[6]; // x y z nx ny nz
-  size_t N = cloud.width * cloud.height;
-  int i = 0;
-  for (auto f : cloud.fields) {
-    printf("cloud fields: %s %u %u\n", f.name.c_str(), f.offset, f.datatype);
-    if (f.name == "x") {
-      has_point = true;
-      if (f.datatype == pcl::PCLPointField::PointFieldTypes::FLOAT64) {
-        std::cout << "Cloud is DOUBLE" << std::endl;
+  // decode the fields straight into the vertices
+  size_t N = header.points;
+  vcg::tri::Allocator<CMesh>::AddVertices(mesh, N);
+  std::vector<std::string> names;
+  std::vector<PointIO::FloatSink> sinks;
+  if (N > 0) {
+    for (int k = 0; k < 3; k++) {
+      names.push_back(std::string(1, char('x' + k)));
+      sinks.push_back(PointIO::FloatSink((char*)&mesh.vert[0].P()[k], sizeof(CVertex)));
+    }
+    if (has_normal) {
+      for (int k = 0; k < 3; k++) {
+        names.push_back(std::string("normal_") + char('x' + k));
+        sinks.push_back(PointIO::FloatSink((char*)&mesh.vert[0].N()[k], sizeof(CVertex)));
       }
-      findex[0] = i;
-    } else if (f.name == "y") {
-      has_point = true;
-      findex[1] = i;
-    } else if (f.name == "z") {
-      has_point = true;
-      findex[2] = i;
-    } else if (f.name == "normal_x") {
-      has_normal = true;
-      findex[3] = i;
-    } else if (f.name == "normal_y") {
-      has_normal = true;
-      findex[4] = i;
-    } else if (f.name == "normal_z") {
-      has_normal = true;
-      findex[5] = i;
     }
-    ++i;
   }
-  if (!has_point) {
-    std::cerr << "PCD must contains x,y,z fields. NO POINTS LOADED." << std::endl;
+  if (!PointIO::decodePCD(file, header, names, sinks, error)) {
+    LOG_ERROR << filename << ": " << error << ". NO POINTS LOADED.";
+    clearCMesh(mesh);
     return;
   }
 
-  if (!is_sample) {
-    clearCMesh(original);
+  LOG_INFO << "Loaded " << N << " points from " << filename;
+  for (size_t i = 0; i < N; ++i) {
+    CVertex& v = mesh.vert[i];
+    v.bIsOriginal = !is_sample;
+    v.m_index = i;
+    mesh.bbox.Add(v.P());
+  }
+  mesh.vn = mesh.vert.size();
+}
+
+// load a point file into the original, the reader follows the extension
+bool DataMgr::loadOriginal(const std::string& filename)
+{
+  Profiler::Scope profile("loadOriginal");
+  std::string ext;
+  size_t dot = filename.find_last_of('.');
+  if (dot != std::string::npos) {
+    ext = filename.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  }
+
+  if (ext == ".pcd") {
+    loadPCD(filename, false);
+  } else if (ext == ".ply") {
+    loadPlyToOriginal(filename.c_str());
+  } else if (ext == ".xyz" || ext == ".xyzn" || ext == ".txt") {
+    loadText(filename, false, ext == ".xyzn");
   } else {
-    clearCMesh(samples);
+    LOG_ERROR << "Unsupported point file: " << filename;
+    return false;
   }
-  curr_file_name = filename.c_str();
-  // iterate through the cloud and extract the points and normals
-  auto vi = vcg::tri::Allocator<CMesh>::AddVertices(is_sample ? samples : original,N);
-  uint8_t* data = &cloud.data[0];
-  std::cout << "Loading " << N << " points..." << std::endl;
-  for (size_t i = 0, o = 0; i < N; ++i, o += cloud.point_step) {
-    auto pt = &data[o];
-    float x,y,z;
-    x = get_field(pt, cloud.fields[findex[0]]);
-    y = get_field(pt, cloud.fields[findex[1]]);
-    z = get_field(pt, cloud.fields[findex[2]]);
-    vi->P()[0] = x;
-    vi->P()[1] = y;
-    vi->P()[2] = z; // WHY??
-    if (has_normal) {
-      x = get_field(pt, cloud.fields[findex[3]]);
-      y = get_field(pt, cloud.fields[findex[4]]);
-      z = get_field(pt, cloud.fields[findex[5]]);
-      vi->N()[0] = x;
-      vi->N()[1] = y;
-      vi->N()[2] = z; // WHY??
+  return !isOriginalEmpty();
+}
+
+// fill the original from memory, point i is read at (char*)points + i * stride
+// (and its normal likewise, when given)
+void DataMgr::setOriginal(const float* points, size_t count, size_t stride,
+                          const float* normals, size_t normal_stride)
+{
+  clearCMesh(original);
+  if (count == 0) {
+    return;
+  }
+
+  vcg::tri::Allocator<CMesh>::AddVertices(original, count);
+  long long n = count;
+#pragma omp parallel for schedule(static)
+  for (long long i = 0; i < n; i++) {
+    CVertex& v = original.vert[i];
+    const float* p = (const float*)((const char*)points + i * stride);
+    v.P() = Point3f(p[0], p[1], p[2]);
+    if (normals != NULL) {
+      const float* nm = (const float*)((const char*)normals + i * normal_stride);
+      v.N() = Point3f(nm[0], nm[1], nm[2]);
     }
-    vi->bIsOriginal = !is_sample;
-    vi->m_index = i;
-    (is_sample ? samples : original).bbox.Add(vi->P());
-    printf("%lu  %.3f %.3f %.3f\n", (unsigned long)&data[o], vi->P()[0], vi->P()[1], vi->P()[2]);
-    ++vi;
+    v.bIsOriginal = true;
+    v.m_index = i;
+  }
+  for (size_t i = 0; i < count; i++) {
+    original.bbox.Add(original.vert[i].P());
   }
-  (is_sample ? samples : original).vn = (is_sample ? samples : original).vert.size();
+  original.vn = original.vert.size();
 }
 
+// positions, normals, eigen_confidence and the sample flags (as in
+// saveSkeletonAsBinary) as binary_compressed PCD
 void DataMgr::savePCD(const std::string& filename, CMesh& mesh)
 {
-  
+  Profiler::Scope profile("savePCD");
+  const char* names[8] = { "x", "y", "z", "normal_x", "normal_y", "normal_z",
+                           "eigen_confidence", "flags" };
+  vector<PointIO::PCDField> fields(8);
+  for (int k = 0; k < 8; k++) {
+    fields[k].name = names[k];
+    fields[k].size = k < 7 ? 4 : 1;
+    fields[k].type = k < 7 ? 'F' : 'U';
+    fields[k].count = 1;
+    fields[k].offset = 0;
+  }
+
+  long long n = mesh.vert.size();
+  vector<float> values(7 * n);
+  vector<unsigned char> flags(n);
+#pragma omp parallel for schedule(static)
+  for (long long i = 0; i < n; i++) {
+    CVertex& v = mesh.vert[i];
+    for (int k = 0; k < 3; k++) {
+      values[k * n + i] = v.P()[k];
+      values[(3 + k) * n + i] = v.N()[k];
+    }
+    values[6 * n + i] = v.eigen_confidence;
+    flags[i] = packFlags(v);
+  }
+
+  vector<const char*> columns(8);
+  for (int k = 0; k < 7; k++) {
+    columns[k] = (const char*)(values.data() + k * n);
+  }
+  columns[7] = (const char*)flags.data();
+
+  std::string error;
+  if (!PointIO::writePCD(filename, fields, columns, n, error)) {
+    LOG_ERROR << error;
+  }
+}
+
+// Vertex only binary PLY files are decoded in parallel straight from a
+// mapping; false (with nothing loaded) for anything that needs plylib.
+bool DataMgr::loadPlyFast(const std::string& fileName, bool is_sample)
+{
+  Profiler::Scope profile("loadPlyFast");
+  PointIO::MappedFile file;
+  PointIO::PLYHeader header;
+  std::string error;
+  if (!file.open(fileName) || !header.parse(file.data(), file.size(), error)) {
+    return false;
+  }
+  if (header.find("x") < 0 || header.find("y") < 0 || header.find("z") < 0) {
+    return false;
+  }
+
+  CMesh& mesh = is_sample ? samples : original;
+  clearCMesh(mesh);
+  size_t N = header.vertices;
+  vcg::tri::Allocator<CMesh>::AddVertices(mesh, N);
+  if (N == 0) {
+    return true;
+  }
+
+  std::vector<std::string> names;
+  std::vector<PointIO::FloatSink> sinks;
+  const char* normal_names[2][3] = { { "nx", "ny", "nz" }, { "normal_x", "normal_y", "normal_z" } };
+  for (int k = 0; k < 3; k++) {
+    names.push_back(std::string(1, char('x' + k)));
+    sinks.push_back(PointIO::FloatSink((char*)&mesh.vert[0].P()[k], sizeof(CVertex)));
+  }
+  for (int s = 0; s < 2; s++) {
+    if (header.find(normal_names[s][0]) >= 0 && header.find(normal_names[s][1]) >= 0 &&
+        header.find(normal_names[s][2]) >= 0) {
+      for (int k = 0; k < 3; k++) {
+        names.push_back(normal_names[s][k]);
+        sinks.push_back(PointIO::FloatSink((char*)&mesh.vert[0].N()[k], sizeof(CVertex)));
+      }
+      break;
+    }
+  }
+
+  // colors go through floats
+  const char* color_names[3] = { "red", "green", "blue" };
+  bool has_color = header.find("red") >= 0 && header.find("green") >= 0 && header.find("blue") >= 0;
+  vector<float> color;
+  if (has_color) {
+    color.resize(3 * N);
+    for (int k = 0; k < 3; k++) {
+      names.push_back(color_names[k]);
+      sinks.push_back(PointIO::FloatSink((char*)&color[k], 3 * sizeof(float)));
+    }
+  }
+
+  if (!PointIO::decodePLY(file, header, names, sinks, error)) {
+    LOG_ERROR << fileName << ": " << error;
+    clearCMesh(mesh);
+    return false;
+  }
+
+  for (size_t i = 0; i < N; i++) {
+    CVertex& v = mesh.vert[i];
+    if (has_color) {
+      v.C() = Color4b(color[3 * i], color[3 * i + 1], color[3 * i + 2], 255);
+    }
+    v.bIsOriginal = !is_sample;
+    v.m_index = i;
+    mesh.bbox.Add(v.P());
+  }
+  mesh.vn = mesh.vert.size();
+  LOG_INFO << "Loaded " << N << " points from " << fileName;
+  return true;
 }
 
 void DataMgr::loadPlyToOriginal(QString fileName)
 {
 	clearCMesh(original);
 	curr_file_name = fileName;
+	bool loaded = loadPlyFast(fileName.toStdString(), false);
+	original_file_name = fileName.toStdString();
+	if (loaded)
+	{
+		return;
+	}
 
 	int mask= tri::io::Mask::IOM_VERTCOORD + tri::io::Mask::IOM_VERTNORMAL ;
 
 	int err = tri::io::Importer<CMesh>::Open(original, curr_file_name.toAscii().data(), mask);  
 	if(err) 
 	{
-		cout << "Failed reading mesh: " << err << "\n";
+		LOG_ERROR << "Failed reading mesh: " << err;
 		return;
 	}  
-	cout << "points loaded\n";
+	LOG_INFO << "points loaded";
 
 
 	CMesh::VertexIterator vi;
@@ -175,6 +329,10 @@ void DataMgr::loadPlyToSample(QString fileName)
 {
 	clearCMesh(samples);
 	curr_file_name = fileName;
+	if (loadPlyFast(fileName.toStdString(), true))
+	{
+		return;
+	}
 
 	int mask= tri::io::Mask::IOM_VERTCOORD + tri::io::Mask::IOM_VERTNORMAL ;
 	mask += tri::io::Mask::IOM_VERTCOLOR;
@@ -183,7 +341,7 @@ void DataMgr::loadPlyToSample(QString fileName)
 	int err = tri::io::Importer<CMesh>::Open(samples, curr_file_name.toAscii().data(), mask);  
 	if(err) 
 	{
-		cout << "Failed reading mesh: " << err << "\n";
+		LOG_ERROR << "Failed reading mesh: " << err;
 		return;
 	}  
 
@@ -200,41 +358,62 @@ void DataMgr::loadPlyToSample(QString fileName)
 
 void DataMgr::loadXYZN(QString fileName)
 {
-  clearCMesh(samples);
-  ifstream infile;
-  infile.open(fileName.toStdString().c_str());
-
-  int i = 0;
-  while(!infile.eof())
-  {
-    CVertex v;
-    float temp = 0.;
-    for (int j=0; j<3; j++)
-    {
+  loadText(fileName.toStdString(), true, true);
+}
 
-      infile >> temp;
-      v.P()[j] = temp;
-    }
+void DataMgr::loadText(const std::string& filename, bool is_sample, bool normals)
+{
+  Profiler::Scope profile("loadText");
+  PointIO::MappedFile file;
+  PointIO::TextPoints text;
+  std::string error;
+  if (!file.open(filename)) {
+    LOG_ERROR << "Could not open " << filename;
+    return;
+  }
+  if (!text.scan(file, error) || text.columns < 3) {
+    LOG_ERROR << filename << ": " << (error.empty() ? "less than 3 columns" : error)
+              << ". NO POINTS LOADED.";
+    return;
+  }
 
+  CMesh& mesh = is_sample ? samples : original;
+  clearCMesh(mesh);
+  curr_file_name = filename.c_str();
+  if (!is_sample) {
+    original_file_name = filename;
+  }
 
-    for (int j=0; j<3; j++) {
-      infile >> v.N()[j];
+  // the storage is sized from the scan, the lines are parsed straight into it
+  size_t N = text.points;
+  vcg::tri::Allocator<CMesh>::AddVertices(mesh, N);
+  std::vector<PointIO::FloatSink> sinks;
+  for (int k = 0; k < 3; k++) {
+    sinks.push_back(PointIO::FloatSink((char*)&mesh.vert[0].P()[k], sizeof(CVertex)));
+  }
+  if (normals && text.columns < 6) {
+    LOG_WARN << filename << " has no normal columns, only the positions are loaded";
+    normals = false;
+  }
+  if (normals) {
+    for (int k = 0; k < 3; k++) {
+      sinks.push_back(PointIO::FloatSink((char*)&mesh.vert[0].N()[k], sizeof(CVertex)));
     }
-
-    v.m_index = i++;
-
-    samples.vert.push_back(v);
-    samples.bbox.Add(v.P());
+  }
+  if (!text.decode(file, sinks, error)) {
+    LOG_ERROR << filename << ": " << error << ". NO POINTS LOADED.";
+    clearCMesh(mesh);
+    return;
   }
 
- // mesh.vert.erase(mesh.vert.end()-1);
-  samples.vert.pop_back();
-  samples.vn = samples.vert.size();
-
-  infile.close();
-
-
-
+  LOG_INFO << "Loaded " << N << " points from " << filename;
+  for (size_t i = 0; i < N; ++i) {
+    CVertex& v = mesh.vert[i];
+    v.bIsOriginal = !is_sample;
+    v.m_index = i;
+    mesh.bbox.Add(v.P());
+  }
+  mesh.vn = mesh.vert.size();
 }
 
 void DataMgr::loadImage(QString fileName)
@@ -341,37 +520,42 @@ void DataMgr::recomputeBox()
 	}
 }
 
+double DataMgr::initRadius(const Box3f& box, double points, double init_para)
+{
+	double diagonal_length = sqrt((box.min - box.max).SquaredNorm());
+	if ( abs(box.min.X() - box.max.X()) < 1e-5 ||   
+		abs(box.min.Y() - box.max.Y()) < 1e-5 ||   
+		abs(box.min.Z() - box.max.Z()) < 1e-5 )
+	{
+		return 2 * init_para * diagonal_length / sqrt(points);
+	}
+	return init_para * diagonal_length / pow(points, 0.333);
+}
+
 double DataMgr::getInitRadiuse()
 {
 	double init_para = para->getDouble("Init Radius Para");
 	if (!isOriginalEmpty())
 	{
-		Box3f box = original.bbox;
-		if ( abs(box.min.X() - box.max.X()) < 1e-5 ||   
-			abs(box.min.Y() - box.max.Y()) < 1e-5 ||   
-			abs(box.min.Z() - box.max.Z()) < 1e-5 )
-		{
-			double diagonal_length = sqrt((box.min - box.max).SquaredNorm());
-			double original_size = sqrt(double(original.vn));
-			init_radius = 2 * init_para * diagonal_length / original_size;
-		}
-		else
-		{
-			double diagonal_length = sqrt((box.min - box.max).SquaredNorm());
-			double original_size = pow(double(original.vn), 0.333);
-			init_radius = init_para * diagonal_length / original_size;
-		}
+		init_radius = initRadius(original.bbox, original.vn, init_para);
 	}
 
+  // several DataMgr may share global_paraMgr from different threads
+  static std::mutex global_para_mutex;
+  std::unique_lock<std::mutex> lock(global_para_mutex, std::defer_lock);
+  if (paraMgr == &global_paraMgr)
+  {
+    lock.lock();
+  }
   auto r = DoubleValue(init_radius);
-  global_paraMgr.setGlobalParameter("CGrid Radius", r);
-  global_paraMgr.setGlobalParameter("Initial Radius", r);
+  paraMgr->setGlobalParameter("CGrid Radius", r);
+  paraMgr->setGlobalParameter("Initial Radius", r);
 
 	return init_radius;
 }
 
 
-void DataMgr::downSamplesByNum(bool use_random_downsample)
+void DataMgr::downSamplesByNum(bool use_random_downsample, int want_sample_num)
 {
 	if (isOriginalEmpty() && !isSamplesEmpty())
 	{
@@ -384,7 +568,10 @@ void DataMgr::downSamplesByNum(bool use_random_downsample)
 		return;
 	}
 
-	int want_sample_num = para->getDouble("Down Sample Num");
+	if (want_sample_num < 0)
+	{
+		want_sample_num = para->getDouble("Down Sample Num");
+	}
 
 	if (want_sample_num > original.vn)
 	{
@@ -418,6 +605,177 @@ void DataMgr::downSamplesByNum(bool use_random_downsample)
   getInitRadiuse();
 }
 
+// like downSamplesByNum, but the samples are chosen with one of the
+// Sampler::METHOD strategies
+void DataMgr::downSamplesByMethod(int method, int want_sample_num)
+{
+	Profiler::Scope profile("downSamplesByMethod");
+	if (method == Sampler::RANDOM || method == Sampler::ORDERED || isOriginalEmpty())
+	{
+		downSamplesByNum(method == Sampler::RANDOM, want_sample_num);
+		return;
+	}
+
+	if (want_sample_num < 0)
+	{
+		want_sample_num = para->getDouble("Down Sample Num");
+	}
+
+	vector<int> index = Sampler::select(method, original.vert, original.bbox, want_sample_num);
+
+	clearCMesh(samples);
+	samples.vert.reserve(index.size());
+	for (int i = 0; i < index.size(); i++)
+	{
+		CVertex v = original.vert[index[i]];
+		v.bIsOriginal = false;
+		v.m_index = i;
+		samples.vert.push_back(v);
+		samples.bbox.Add(v.P());
+	}
+	samples.vn = samples.vert.size();
+	LOG_INFO << "Selected " << samples.vn << " samples";
+
+	getInitRadiuse();
+}
+
+// keep a random subset of another point set as the original, used to build
+// the coarse levels of the multiresolution skeletonization
+void DataMgr::downOriginalByNum(CMesh& source, int want_original_num)
+{
+	if (want_original_num > source.vn)
+	{
+		want_original_num = source.vn;
+	}
+
+	clearCMesh(original);
+	original.vert.reserve(want_original_num);
+
+	vector<int> nCard = GlobalFun::GetRandomCards(source.vert.size());
+	for(int i = 0; i < want_original_num; i++) 
+	{
+		CVertex v = source.vert[nCard[i]];
+		v.bIsOriginal = true;
+		v.m_index = i;
+		v.neighbors.clear();
+		v.original_neighbors.clear();
+		original.vert.push_back(v);
+		original.bbox.Add(v.P());
+	}
+	original.vn = original.vert.size();
+}
+
+const vector<double>& DataMgr::getOriginalDensity(double radius, double h_gaussian, bool persist)
+{
+	Profiler::Scope profile("getOriginalDensity");
+	unsigned long long hash = hashOriginal();
+	if (original_density.size() == original.vert.size() && original_density_hash == hash
+		&& original_density_radius == radius && original_density_h == h_gaussian)
+	{
+		return original_density;
+	}
+
+	std::string density_file;
+	if (persist && !original_file_name.empty())
+	{
+		density_file = original_file_name + ".density";
+		if (readOriginalDensity(density_file, radius, h_gaussian, hash))
+		{
+			LOG_INFO << "Original density read from " << density_file;
+			return original_density;
+		}
+	}
+
+	GlobalFun::computeBallDensity(&original, radius, -h_gaussian / (radius * radius), original_density);
+	for (int i = 0; i < original_density.size(); i++)
+	{
+		original_density[i] = 1. / original_density[i];
+	}
+	original_density_radius = radius;
+	original_density_h = h_gaussian;
+	original_density_hash = hash;
+
+	if (!density_file.empty())
+	{
+		writeOriginalDensity(density_file, radius, h_gaussian, hash);
+	}
+	return original_density;
+}
+
+// FNV-1a over the point coordinates, cheap next to the density itself and
+// enough to notice that the original was reloaded, resampled or normalized
+unsigned long long DataMgr::hashOriginal()
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (int i = 0; i < original.vert.size(); i++)
+	{
+		const unsigned char* bytes = (const unsigned char*)&original.vert[i].P()[0];
+		for (int b = 0; b < 3 * sizeof(float); b++)
+		{
+			hash = (hash ^ bytes[b]) * 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+static const char density_magic[8] = {'W', 'L', 'O', 'P', 'D', 'E', 'N', '1'};
+
+bool DataMgr::readOriginalDensity(const std::string& fileName, double radius, double h_gaussian, unsigned long long hash)
+{
+	ifstream infile(fileName.c_str(), ios::binary);
+	if (!infile.is_open())
+	{
+		return false;
+	}
+
+	char magic[8];
+	unsigned long long num, file_hash;
+	double file_radius, file_h;
+	infile.read(magic, sizeof(magic));
+	infile.read((char*)&num, sizeof(num));
+	infile.read((char*)&file_radius, sizeof(file_radius));
+	infile.read((char*)&file_h, sizeof(file_h));
+	infile.read((char*)&file_hash, sizeof(file_hash));
+	if (!infile || memcmp(magic, density_magic, sizeof(magic)) != 0 || num != original.vert.size()
+		|| file_radius != radius || file_h != h_gaussian || file_hash != hash)
+	{
+		LOG_WARN << "Stale original density in " << fileName << ", recomputing";
+		return false;
+	}
+
+	vector<double> density(num);
+	infile.read((char*)density.data(), num * sizeof(double));
+	if (!infile)
+	{
+		LOG_WARN << "Truncated original density in " << fileName << ", recomputing";
+		return false;
+	}
+
+	original_density.swap(density);
+	original_density_radius = radius;
+	original_density_h = h_gaussian;
+	original_density_hash = hash;
+	return true;
+}
+
+void DataMgr::writeOriginalDensity(const std::string& fileName, double radius, double h_gaussian, unsigned long long hash)
+{
+	ofstream outfile(fileName.c_str(), ios::binary);
+	if (!outfile.is_open())
+	{
+		LOG_WARN << "Could not write original density to " << fileName;
+		return;
+	}
+
+	unsigned long long num = original_density.size();
+	outfile.write(density_magic, sizeof(density_magic));
+	outfile.write((const char*)&num, sizeof(num));
+	outfile.write((const char*)&radius, sizeof(radius));
+	outfile.write((const char*)&h_gaussian, sizeof(h_gaussian));
+	outfile.write((const char*)&hash, sizeof(hash));
+	outfile.write((const char*)original_density.data(), num * sizeof(double));
+}
+
 void DataMgr::subSamples()
 {
 	clearCMesh(original);
@@ -438,8 +796,59 @@ void DataMgr::subSamples()
 }
 
 
+// positions, normals and colors of a mesh without faces
+bool DataMgr::savePlyFast(const std::string& fileName, CMesh& mesh)
+{
+  Profiler::Scope profile("savePlyFast");
+  const char* names[10] = { "x", "y", "z", "nx", "ny", "nz", "red", "green", "blue", "alpha" };
+  vector<PointIO::PCDField> fields(10);
+  for (int k = 0; k < 10; k++) {
+    fields[k].name = names[k];
+    fields[k].size = k < 6 ? 4 : 1;
+    fields[k].type = k < 6 ? 'F' : 'U';
+    fields[k].count = 1;
+    fields[k].offset = 0;
+  }
+
+  long long n = mesh.vert.size();
+  vector<float> values(6 * n);
+  vector<unsigned char> colors(4 * n);
+#pragma omp parallel for schedule(static)
+  for (long long i = 0; i < n; i++) {
+    CVertex& v = mesh.vert[i];
+    for (int k = 0; k < 3; k++) {
+      values[k * n + i] = v.P()[k];
+      values[(3 + k) * n + i] = v.N()[k];
+    }
+    for (int k = 0; k < 4; k++) {
+      colors[k * n + i] = v.C()[k];
+    }
+  }
+
+  vector<const char*> columns(10);
+  for (int k = 0; k < 6; k++) {
+    columns[k] = (const char*)(values.data() + k * n);
+  }
+  for (int k = 0; k < 4; k++) {
+    columns[6 + k] = (const char*)(colors.data() + k * n);
+  }
+
+  std::string error;
+  if (!PointIO::writePLY(fileName, fields, columns, n, error)) {
+    LOG_ERROR << error;
+    return false;
+  }
+  return true;
+}
+
 void DataMgr::savePly(QString fileName, CMesh& mesh)
 {
+	if (fileName.endsWith("ply") && mesh.face.empty() &&
+	    savePlyFast(fileName.toStdString(), mesh))
+	{
+		return;
+	}
+
 	int mask= tri::io::Mask::IOM_VERTCOORD + tri::io::Mask::IOM_VERTNORMAL ;
 	mask += tri::io::Mask::IOM_VERTCOLOR;
 	mask += tri::io::Mask::IOM_BITPOLYGONAL;
@@ -547,6 +956,7 @@ void DataMgr::recomputeQuad()
 
 void DataMgr::saveSkeletonAsSkel(QString fileName)
 {
+	Profiler::Scope profile("saveSkeletonAsSkel");
 	ofstream outfile;
 	outfile.open(fileName.toStdString().c_str());
 
@@ -685,6 +1095,178 @@ void DataMgr::saveSkeletonAsSkel(QString fileName)
 	outfile.close();
 }
 
+static void addPositions(PointIO::SkelWriter& writer, const std::string& prefix, CMesh& mesh)
+{
+  long long n = mesh.vert.size();
+  vector<float> position(3 * n), normal(3 * n);
+#pragma omp parallel for schedule(static)
+  for (long long i = 0; i < n; i++) {
+    for (int k = 0; k < 3; k++) {
+      position[3 * i + k] = mesh.vert[i].P()[k];
+      normal[3 * i + k] = mesh.vert[i].N()[k];
+    }
+  }
+  writer.add(prefix + ".position", PointIO::SKEL_F32, 3, n, position.data());
+  writer.add(prefix + ".normal", PointIO::SKEL_F32, 3, n, normal.data());
+}
+
+bool DataMgr::saveSkeletonAsBinary(const std::string& fileName)
+{
+  Profiler::Scope profile("saveSkeletonAsBinary");
+  PointIO::SkelWriter writer;
+  addPositions(writer, "original", original);
+  addPositions(writer, "sample", samples);
+
+  size_t n = samples.vert.size();
+  vector<float> confidence(n);
+  vector<unsigned char> flags(n);
+  vector<int> group(n);
+  for (size_t i = 0; i < n; i++) {
+    CVertex& v = samples.vert[i];
+    confidence[i] = v.eigen_confidence;
+    flags[i] = packFlags(v);
+    group[i] = v.m_index;
+  }
+  writer.add("sample.confidence", PointIO::SKEL_F32, 1, n, confidence.data());
+  writer.add("sample.flags", PointIO::SKEL_U8, 1, n, flags.data());
+  writer.add("sample.group", PointIO::SKEL_I32, 1, n, group.data());
+
+  // the nodes of all branches in a row, branch i owns [offset[i], offset[i+1])
+  vector<unsigned int> offset(1, 0);
+  vector<float> node_position, node_radius;
+  vector<unsigned char> node_virtual;
+  vector<int> node_sample;
+  for (size_t i = 0; i < skeleton.branches.size(); i++) {
+    Curve& curve = skeleton.branches[i].curve;
+    for (size_t j = 0; j < curve.size(); j++) {
+      for (int k = 0; k < 3; k++) {
+        node_position.push_back(curve[j].P()[k]);
+      }
+      node_radius.push_back(curve[j].skel_radius);
+      node_virtual.push_back(curve[j].is_skel_virtual);
+      node_sample.push_back(curve[j].m_index);
+    }
+    offset.push_back(node_radius.size());
+  }
+  writer.add("branch.offset", PointIO::SKEL_U32, 1, offset.size(), offset.data());
+  writer.add("node.position", PointIO::SKEL_F32, 3, node_radius.size(), node_position.data());
+  writer.add("node.radius", PointIO::SKEL_F32, 1, node_radius.size(), node_radius.data());
+  writer.add("node.virtual", PointIO::SKEL_U8, 1, node_virtual.size(), node_virtual.data());
+  writer.add("node.sample", PointIO::SKEL_I32, 1, node_sample.size(), node_sample.data());
+
+  std::string error;
+  if (!writer.write(fileName, error)) {
+    LOG_ERROR << error;
+    return false;
+  }
+  return true;
+}
+
+static void readPositions(const PointIO::SkelReader& reader, const std::string& prefix,
+                          CMesh& mesh, bool is_original)
+{
+  const PointIO::SkelSection* position = reader.find(prefix + ".position", PointIO::SKEL_F32, 3);
+  if (position == NULL) {
+    return;
+  }
+  const PointIO::SkelSection* normal = reader.find(prefix + ".normal", PointIO::SKEL_F32, 3);
+  if (normal != NULL && normal->count != position->count) {
+    normal = NULL;
+  }
+
+  long long n = position->count;
+  vcg::tri::Allocator<CMesh>::AddVertices(mesh, n);
+  const float* p = (const float*)reader.data(*position);
+  const float* nm = normal ? (const float*)reader.data(*normal) : NULL;
+#pragma omp parallel for schedule(static)
+  for (long long i = 0; i < n; i++) {
+    CVertex& v = mesh.vert[i];
+    v.P() = Point3f(p[3 * i], p[3 * i + 1], p[3 * i + 2]);
+    if (nm != NULL) {
+      v.N() = Point3f(nm[3 * i], nm[3 * i + 1], nm[3 * i + 2]);
+    }
+    v.bIsOriginal = is_original;
+    v.m_index = i;
+  }
+  for (long long i = 0; i < n; i++) {
+    mesh.bbox.Add(mesh.vert[i].P());
+  }
+  mesh.vn = mesh.vert.size();
+}
+
+bool DataMgr::loadSkeletonFromBinary(const std::string& fileName)
+{
+  Profiler::Scope profile("loadSkeletonFromBinary");
+  PointIO::SkelReader reader;
+  std::string error;
+  if (!reader.open(fileName, error)) {
+    LOG_ERROR << error;
+    return false;
+  }
+
+  clearCMesh(samples);
+  clearCMesh(original);
+  skeleton.clear();
+  readPositions(reader, "original", original, true);
+  readPositions(reader, "sample", samples, false);
+
+  size_t n = samples.vert.size();
+  const PointIO::SkelSection* s = reader.find("sample.confidence", PointIO::SKEL_F32, 1);
+  if (s != NULL && s->count == n) {
+    const float* confidence = (const float*)reader.data(*s);
+    for (size_t i = 0; i < n; i++) {
+      samples.vert[i].eigen_confidence = confidence[i];
+    }
+  }
+  s = reader.find("sample.flags", PointIO::SKEL_U8, 1);
+  if (s != NULL && s->count == n) {
+    const unsigned char* flags = (const unsigned char*)reader.data(*s);
+    for (size_t i = 0; i < n; i++) {
+      CVertex& v = samples.vert[i];
+      v.is_fixed_sample = (flags[i] & FLAG_FIXED) != 0;
+      v.is_skel_branch = (flags[i] & FLAG_BRANCH) != 0;
+      v.is_skel_virtual = (flags[i] & FLAG_VIRTUAL) != 0;
+      v.is_skel_ignore = (flags[i] & FLAG_IGNORE) != 0;
+    }
+  }
+
+  const PointIO::SkelSection* offset = reader.find("branch.offset", PointIO::SKEL_U32, 1);
+  const PointIO::SkelSection* position = reader.find("node.position", PointIO::SKEL_F32, 3);
+  if (offset == NULL || position == NULL || offset->count == 0) {
+    return true;
+  }
+  const unsigned int* first = (const unsigned int*)reader.data(*offset);
+  const float* p = (const float*)reader.data(*position);
+  size_t nodes = position->count;
+  const PointIO::SkelSection* radius = reader.find("node.radius", PointIO::SKEL_F32, 1);
+  const PointIO::SkelSection* is_virtual = reader.find("node.virtual", PointIO::SKEL_U8, 1);
+  const PointIO::SkelSection* sample = reader.find("node.sample", PointIO::SKEL_I32, 1);
+  const float* r = (radius && radius->count == nodes) ? (const float*)reader.data(*radius) : NULL;
+  const unsigned char* virt = (is_virtual && is_virtual->count == nodes) ?
+                              (const unsigned char*)reader.data(*is_virtual) : NULL;
+  const int* index = (sample && sample->count == nodes) ? (const int*)reader.data(*sample) : NULL;
+
+  for (size_t i = 0; i + 1 < offset->count; i++) {
+    if (first[i] > first[i + 1] || first[i + 1] > nodes) {
+      LOG_ERROR << "bad branch offsets in " << fileName;
+      skeleton.clear();
+      return false;
+    }
+    Branch branch;
+    for (unsigned int j = first[i]; j < first[i + 1]; j++) {
+      CVertex v;
+      v.P() = Point3f(p[3 * j], p[3 * j + 1], p[3 * j + 2]);
+      v.skel_radius = r ? r[j] : -1;
+      v.is_skel_virtual = virt ? virt[j] != 0 : false;
+      v.m_index = index ? index[j] : -1;
+      branch.curve.push_back(v);
+    }
+    skeleton.branches.push_back(branch);
+  }
+  skeleton.generateBranchSampleMap();
+  return true;
+}
+
 
 
 
@@ -22,10 +22,16 @@ using namespace tri;
 class DataMgr
 {
 public:
-	DataMgr(RichParameterSet* _para);
+	DataMgr(RichParameterSet* _para, ParameterMgr* _paraMgr = &global_paraMgr);
 	~DataMgr(void);
 
   void loadPCD(const std::string& filename, bool is_sample = false);
+  // .xyz/.xyzn/.txt: x y z in the first three columns and, with normals,
+  // nx ny nz in the next three; other columns (intensity, color) are skipped
+  void loadText(const std::string& filename, bool is_sample = false, bool normals = false);
+  bool loadOriginal(const std::string& filename);
+  void setOriginal(const float* points, size_t count, size_t stride,
+                   const float* normals = NULL, size_t normal_stride = 0);
   void savePCD(const std::string& filename, CMesh& mesh);
   
 	void loadPlyToOriginal(QString fileName);
@@ -45,8 +51,12 @@ public:
 
 	void recomputeBox();
 	double getInitRadiuse();
+	// the initial radius of points spread over box, init_para is "Init Radius Para"
+	static double initRadius(const Box3f& box, double points, double init_para);
 
-	void downSamplesByNum(bool use_random_downsample = true);
+	void downSamplesByNum(bool use_random_downsample = true, int want_sample_num = -1);
+	void downSamplesByMethod(int method, int want_sample_num = -1);
+	void downOriginalByNum(CMesh& source, int want_original_num);
 	void subSamples();
 
 	void normalizeROSA_Mesh(CMesh& mesh);
@@ -58,10 +68,24 @@ public:
 
 	void loadSkeletonFromSkel(QString fileName);
 	void saveSkeletonAsSkel(QString fileName);
+	// the same content as a .skel in the binary format of PointIO::SkelWriter
+	bool loadSkeletonFromBinary(const std::string& fileName);
+	bool saveSkeletonAsBinary(const std::string& fileName);
+
+	// inverse original density (see GlobalFun::computeBallDensity), cached until
+	// the original points or the parameters change. With persist the values are
+	// also read from and written to "<original file>.density"
+	const vector<double>& getOriginalDensity(double radius, double h_gaussian, bool persist = false);
+	// FNV-1a of the original coordinates
+	unsigned long long hashOriginal();
 
 
 private:
 	void clearCMesh(CMesh& mesh);
+	bool loadPlyFast(const std::string& fileName, bool is_sample);
+	bool savePlyFast(const std::string& fileName, CMesh& mesh);
+	bool readOriginalDensity(const std::string& fileName, double radius, double h_gaussian, unsigned long long hash);
+	void writeOriginalDensity(const std::string& fileName, double radius, double h_gaussian, unsigned long long hash);
 
 public:
 	CMesh original;
@@ -70,7 +94,15 @@ public:
 	//cv::Mat image;
 
 	RichParameterSet* para;
+	ParameterMgr* paraMgr;	// the sets getInitRadiuse updates
 	double init_radius;
 	QString curr_file_name;
+
+private:
+	std::string original_file_name;
+	vector<double> original_density;
+	double original_density_radius;
+	double original_density_h;
+	unsigned long long original_density_hash;
 };
 
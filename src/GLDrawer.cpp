@@ -598,12 +598,12 @@ void GLDrawer::generateRandomColorList(int num)
 
   random_color_list.clear();
 
-  srand(time(NULL));
+  Random::Generator random = Random::stream(Random::key("branch colors"));
   for(int i = 0; i < num; i++)
   {
-    double r = (rand() % 1000) * 0.001;
-    double g = (rand() % 1000) * 0.001;
-    double b = (rand() % 1000) * 0.001;
+    double r = random.below(1000) * 0.001;
+    double g = random.below(1000) * 0.001;
+    double b = random.below(1000) * 0.001;
     random_color_list.push_back(GLColor(r, g, b));
   }
 }
\ No newline at end of file
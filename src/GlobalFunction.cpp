@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <stdlib.h>
 #include <assert.h>
+#include <mutex>
 
 #include <Eigen/Eigenvalues>
 
@@ -30,7 +31,6 @@ void eigen_decomp(MT& cov, VT& val, MT& vec)
   
   int r = 2;
   for (int i = 0; i < 3; ++i) val[i] = eval[r--];
-  std::cout << std::endl;
   
   r = 3;
   for (int j = 0; j < 3; ++j) {
@@ -127,7 +127,7 @@ void GlobalFun::computeBallNeighbors(CMesh* mesh0, CMesh* mesh1, double radius,
 {
 	if (radius < 0.0001) // TODO: this could be a problem
 	{
-		cout << "too small grid!!" << endl; 
+		LOG_WARN << "too small grid!!"; 
 		return;
 	}
 	//mesh1 should be original
@@ -162,13 +162,85 @@ void GlobalFun::computeBallNeighbors(CMesh* mesh0, CMesh* mesh1, double radius,
 
 }
 
+// density[i] = 1 + sum of exp(dist2 * iradius16) over the other points of mesh
+// within radius of vert i. The sums are accumulated while walking the grid, so
+// unlike computeBallNeighbors no neighbor list is ever stored; every point is
+// only written by the thread owning its cell.
+void GlobalFun::computeBallDensity(CMesh* mesh, double radius, double iradius16, vector<double>& density)
+{
+	density.assign(mesh->vert.size(), 1.);
+	if (radius < 0.0001 || mesh->vert.empty())
+	{
+		LOG_WARN << "too small grid!!"; 
+		return;
+	}
+
+	CGrid grid;
+	grid.init(mesh->vert, mesh->bbox, radius);
+
+	double radius2 = radius * radius;
+	CVertex* first = &mesh->vert[0];
+	int cell_num = grid.xside * grid.yside * grid.zside;
+
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int c = 0; c < cell_num; c++)
+	{
+		if (grid.isEmpty(c))
+		{
+			continue;
+		}
+
+		int x = c % grid.xside;
+		int y = (c / grid.xside) % grid.yside;
+		int z = c / (grid.xside * grid.yside);
+
+		for (CGrid::iterator dest = grid.startV(c); dest != grid.endV(c); dest++)
+		{
+			Point3f& p = (*dest)->P();
+			double sum = 1.;
+
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				if (z + dz < 0 || z + dz >= grid.zside) continue;
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					if (y + dy < 0 || y + dy >= grid.yside) continue;
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						if (x + dx < 0 || x + dx >= grid.xside) continue;
+
+						int other = grid.cell(x + dx, y + dy, z + dz);
+						for (CGrid::iterator origin = grid.startV(other); origin != grid.endV(other); origin++)
+						{
+							if (origin == dest) continue;
+
+							double dist2 = (p - (*origin)->P()).SquaredNorm();
+							if (dist2 < radius2)
+							{
+								sum += exp(dist2 * iradius16);
+							}
+						}
+					}
+				}
+			}
+			density[*dest - first] = sum;
+		}
+	}
+}
+
+
+// ANN keeps the state of a search (ANNkdQ, ANNkdDim, ANNkdPts, ...) in
+// globals and shares one empty leaf between all trees, so searches of
+// different threads are serialized and annClose(), which frees that leaf,
+// is never called
+static std::mutex ann_mutex;
 
 void GlobalFun::computeAnnNeigbhors(vector<CVertex> &datapts,
                                     vector<CVertex> &querypts,
                                     int knn, bool need_self_included = false,
                                     QString purpose = "?_?")
 {
-	cout << endl <<"Compute ANN for:	 " << purpose.toStdString() << endl;
+	LOG_DEBUG << "Compute ANN for:	 " << purpose.toStdString();
 	int numKnn = knn + 1;
 
 	if (querypts.size() <= numKnn+2)
@@ -198,7 +270,7 @@ void GlobalFun::computeAnnNeigbhors(vector<CVertex> &datapts,
 
 	if (datapts.size() >= maxPts)
 	{
-		cout << "Too many data" << endl;
+		LOG_WARN << "Too many data";
 		return;
 	}
 
@@ -224,6 +296,7 @@ void GlobalFun::computeAnnNeigbhors(vector<CVertex> &datapts,
 
 	knn++;
 
+	std::lock_guard<std::mutex> ann_lock(ann_mutex);
 	kdTree = new ANNkd_tree(					// build search structure
 		dataPts,					// the data points
 		nPts,						// number of points
@@ -255,7 +328,8 @@ void GlobalFun::computeAnnNeigbhors(vector<CVertex> &datapts,
 	delete [] nnIdx;							// clean things up
 	delete [] dists;
 	delete kdTree;
-	annClose();									// done with ANN
+	annDeallocPt(queryPt);
+	annDeallocPts(dataPts);
 }
 
 
@@ -280,11 +354,10 @@ void GlobalFun::computeKnnNeigbhors(vector<CVertex> &datapts, vector<CVertex> &q
 	//	isComputingOriginalNeighbor = true;
 	//}
 
-	int starttime, stoptime, timeused;
-	starttime = clock();
+	Timer time;
+	time.start("computeAnnNeigbhors");
 
-	cout << endl;
-	cout << "compute KNN Neighbors for: " << purpose.toStdString() << endl;
+	LOG_DEBUG << "compute KNN Neighbors for: " << purpose.toStdString();
 
 
 	ofstream outfile1;
@@ -336,7 +409,7 @@ void GlobalFun::computeKnnNeigbhors(vector<CVertex> &datapts, vector<CVertex> &q
 	//cout << mycmd;
 
 	if (system(mycmd) != 0) {
-    std::cerr << "Error making system call to RG_NearestNeighbors.exe" << std::endl;
+    LOG_ERROR << "Error making system call to RG_NearestNeighbors.exe";
     throw std::runtime_error("System call error: RG_NearestNeighbors.exe");
   }
 
@@ -395,22 +468,25 @@ void GlobalFun::computeKnnNeigbhors(vector<CVertex> &datapts, vector<CVertex> &q
 	delete[] data;
 	//cout << "compute_knn_neighbor end." << endl << endl;
 
-	stoptime = clock();
-	timeused = stoptime - starttime;
-	cout << "KNN time used:  " << timeused/double(CLOCKS_PER_SEC) << " seconds." << endl;
-	cout << endl;
+	time.end();
+	LOG_DEBUG << "KNN time used:  " << time.getTimeUsed() << " seconds.";
 }		
 
 
+// a random permutation of 0..Max-1 from the generator of the thread
 vector<int> GlobalFun::GetRandomCards(int Max)
 {
 	vector<int> nCard(Max, 0);
-	srand(time(NULL));
 	for(int i=0; i < Max; i++)
 	{
 		nCard[i] = i;
 	}
-	random_shuffle(nCard.begin(), nCard.begin() + Max);
+
+	Random::Generator& random = Random::local();
+	for (int i = Max - 1; i > 0; i--)
+	{
+		swap(nCard[i], nCard[random.below(i + 1)]);
+	}
 
 
 	return nCard;
@@ -781,7 +857,7 @@ double GlobalFun::computeRealAngleOfTwoVertor(Point3f v0, Point3f v1)
 
 	if (angle < 0 || angle > 180)
 	{
-		cout << "compute angle wrong!!" << endl;
+		LOG_DEBUG << "compute angle wrong!!";
 		//system("Pause");
 		return -1;
 	}
@@ -12,9 +12,12 @@
 #include <time.h>
 #include <string>
 #include <ctime>
+#include <chrono>
 #include<algorithm>
 #include <math.h>
 #include "ANN/ANN.h"
+#include "Profiler.h"
+#include "Log.h"
 
 #define EIGEN_DEFAULT_TO_ROW_MAJOR
 #define EIGEN_EXCEPTIONS
@@ -40,6 +43,7 @@ namespace GlobalFun
 
 	void computeAnnNeigbhors(vector<CVertex> &datapts, vector<CVertex> &querypts, int numKnn, bool need_self_included, QString purpose);
 	void computeBallNeighbors(CMesh* mesh0, CMesh* mesh1, double radius, vcg::Box3f& box);
+	void computeBallDensity(CMesh* mesh, double radius, double iradius16, vector<double>& density);
 
 	void static  __cdecl self_neighbors(CGrid::iterator start, CGrid::iterator end, double radius);
 	void static  __cdecl other_neighbors(CGrid::iterator starta, CGrid::iterator enda, 
@@ -62,38 +66,53 @@ namespace GlobalFun
 	bool isTwoPoint3fOpposite(Point3f& v0, Point3f& v1);
 }
 
+// Wall-clock time of one section, which is also a Profiler section below the
+// innermost open one. start() ends the section still running.
 class Timer
 {
 public:
+	typedef std::chrono::steady_clock Clock;
+
+	Timer() : running(false), timeused(0) {}
+	~Timer() { end(); }
 
 	void start(const string& str)
 	{
-		cout << endl;
-		starttime = clock();
-		mid_start = clock();
-		//cout << "@@@@@ Time Count Strat For: " << str << endl;
-
+		end();
 		_str = str;
+		running = true;
+		Profiler::begin(str);
+		starttime = Clock::now();
+		mid_start = starttime;
 	}
 
 	void insert(const string& str)
 	{
-		mid_end = clock();
-		timeused = mid_end - mid_start;
-		cout << "##" << str << "  time used:  " << timeused / double(CLOCKS_PER_SEC) << " seconds." << endl;
-		mid_start = clock();
+		Clock::time_point mid_end = Clock::now();
+		LOG_DEBUG << "##" << str << "  time used:  " << seconds(mid_end - mid_start) << " seconds.";
+		mid_start = mid_end;
 	}
 
 	void end()
 	{
-		stoptime = clock();
-		timeused = stoptime - starttime;
-		//cout << /*endl <<*/ "@@@@ finish	" << _str << "  time used:  " << timeused / double(CLOCKS_PER_SEC) << " seconds." << endl;
-		//cout << endl;
+		if (!running)
+		{
+			return;
+		}
+		timeused = seconds(Clock::now() - starttime);
+		running = false;
+		Profiler::end();
 	}
 
+	// seconds of the last finished section
+	double getTimeUsed(){ return timeused; }
+
 private:
-	int starttime, mid_start, mid_end, stoptime, timeused;
+	static double seconds(Clock::duration d){ return std::chrono::duration<double>(d).count(); }
+
+	Clock::time_point starttime, mid_start;
+	bool running;
+	double timeused;
 	string _str;
 };
 
@@ -0,0 +1,113 @@
+#include "Log.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+using namespace std;
+
+namespace Log {
+
+std::atomic<int> current_level(LEVEL_INFO);
+
+// The queue and its thread are never destroyed, so messages from static
+// destructors still work; flush runs at exit instead.
+class Writer {
+  public:
+    Writer() : busy(false) {
+      thread(&Writer::run, this).detach();
+    }
+
+    void push(int level, string message) {
+      {
+        lock_guard<mutex> lock(queue_mutex);
+        queue.push_back(make_pair(level, std::move(message)));
+      }
+      wake.notify_one();
+    }
+
+    void flush() {
+      unique_lock<mutex> lock(queue_mutex);
+      done.wait(lock, [&]() { return queue.empty() && !busy; });
+    }
+
+  private:
+    void run() {
+      deque<pair<int, string> > batch;
+      for(;;) {
+        {
+          unique_lock<mutex> lock(queue_mutex);
+          busy = false;
+          done.notify_all();
+          wake.wait(lock, [&]() { return !queue.empty(); });
+          batch.swap(queue);
+          busy = true;
+        }
+        // one write per stream and batch, flushed when the batch is done
+        bool out = false, err = false;
+        for(size_t i = 0; i < batch.size(); i++) {
+          FILE *stream = batch[i].first <= LEVEL_WARN ? stderr : stdout;
+          fwrite(batch[i].second.data(), 1, batch[i].second.size(), stream);
+          (stream == stderr ? err : out) = true;
+        }
+        if(out)
+          fflush(stdout);
+        if(err)
+          fflush(stderr);
+        batch.clear();
+      }
+    }
+
+    mutex queue_mutex;
+    condition_variable wake, done;
+    deque<pair<int, string> > queue;
+    bool busy;
+};
+
+static void flushAtExit() {
+  flush();
+}
+
+static Writer &writer() {
+  static Writer *w = []() {
+    Writer *created = new Writer();
+    atexit(flushAtExit);
+    return created;
+  }();
+  return *w;
+}
+
+void setLevel(int level) {
+  current_level = level;
+}
+
+int getLevel() {
+  return current_level;
+}
+
+int levelFromName(const std::string &name) {
+  if(name == "error") return LEVEL_ERROR;
+  if(name == "warn") return LEVEL_WARN;
+  if(name == "info") return LEVEL_INFO;
+  if(name == "debug") return LEVEL_DEBUG;
+  if(name == "trace") return LEVEL_TRACE;
+  return -1;
+}
+
+void write(int level, const std::string &message) {
+  if(message.empty() || message[message.size() - 1] != '\n')
+    writer().push(level, message + "\n");
+  else
+    writer().push(level, message);
+  if(level == LEVEL_ERROR)
+    writer().flush();
+}
+
+void flush() {
+  writer().flush();
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <sstream>
+#include <string>
+
+// Leveled logging. A message is written as
+//   LOG_INFO << "Selected " << n << " samples";
+// and costs one comparison when its level is disabled: the operands are not
+// evaluated. Levels above LOG_MAX_LEVEL are removed at compile time.
+// Messages are queued and written by a background thread, warnings and
+// errors to stderr and the rest to stdout; errors wait until they are
+// written, and everything is flushed at exit.
+namespace Log {
+
+enum LEVEL { LEVEL_ERROR = 0, LEVEL_WARN = 1, LEVEL_INFO = 2, LEVEL_DEBUG = 3, LEVEL_TRACE = 4 };
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL 4
+#endif
+
+extern std::atomic<int> current_level;
+
+inline bool isEnabled(int level) {
+  return level <= LOG_MAX_LEVEL && level <= current_level.load(std::memory_order_relaxed);
+}
+
+void setLevel(int level);
+int getLevel();
+
+// parse "error", "warn", "info", "debug" or "trace", -1 if unknown
+int levelFromName(const std::string &name);
+
+// queue one message, a newline is added unless it ends with one
+void write(int level, const std::string &message);
+
+// wait until every queued message is written
+void flush();
+
+// one message, queued when the statement ends
+class Line {
+  public:
+    explicit Line(int _level) : level(_level) {}
+    ~Line() { write(level, stream.str()); }
+
+    template <typename T>
+    Line &operator<<(const T &value) {
+      stream << value;
+      return *this;
+    }
+
+    // std::endl and the other manipulators
+    Line &operator<<(std::ostream &(*manipulator)(std::ostream &)) {
+      stream << manipulator;
+      return *this;
+    }
+
+  private:
+    Line(const Line &);
+    Line &operator=(const Line &);
+
+    int level;
+    std::ostringstream stream;
+};
+
+// turns the message into void so it fits the conditional operator
+struct Voidify {
+  void operator&(const Line &) {}
+};
+
+}
+
+#define LOG_AT(level) \
+  !Log::isEnabled(level) ? (void)0 : Log::Voidify() & Log::Line(level)
+
+#define LOG_ERROR LOG_AT(Log::LEVEL_ERROR)
+#define LOG_WARN LOG_AT(Log::LEVEL_WARN)
+#define LOG_INFO LOG_AT(Log::LEVEL_INFO)
+#define LOG_DEBUG LOG_AT(Log::LEVEL_DEBUG)
+#define LOG_TRACE LOG_AT(Log::LEVEL_TRACE)
+
+#endif
@@ -31,6 +31,7 @@ using std::cout;
 //#include <wrap/qt/col_qt_convert.h>
 
 #include "Parameter.h"
+#include "Log.h"
 
 
 using namespace vcg;
@@ -55,7 +56,7 @@ RichParameter* RichParameterSet::findParameter(QString name) const
 		if((*fpli != NULL) && (*fpli)->name==name)
 			return *fpli;
 	}
-	cout << "wrong name: " << name.toStdString() << endl;
+	LOG_ERROR << "wrong name: " << name.toStdString();
 
 	qDebug("FilterParameter Warning: Unable to find a parameter with name '%s',\n"
 		"      Please check types and names of the parameter in the calling filter",qPrintable(name));
@@ -73,7 +74,7 @@ RichParameterSet& RichParameterSet::addParam(RichParameter* pd )
 	assert(!hasParameter(pd->name));
 	if (hasParameter(pd->name))
 	{
-		std::cout << pd->name.toStdString() << endl;
+		LOG_ERROR << pd->name.toStdString();
 	}
 	
 	paramList.push_back(pd);
@@ -1,19 +1,12 @@
 #include "ParameterMgr.h"
 #include <iostream>
 
-int ParameterMgr::init_time = 0;
 ParameterMgr global_paraMgr;
 
+// every instance holds its own sets, so a pipeline can run on a private
+// ParameterMgr (see SkeletonContext) next to global_paraMgr
 ParameterMgr::ParameterMgr(void)
 {
-  std::cout << "ParameterMgr()" << std::endl;
-	init_time++;
-	if(init_time > 1)
-	{
-		std::cout << "can not init ParameterMgr twice!" << endl;
-		return;
-	}
-
 	grid_r = 0.2;
 
 
@@ -157,6 +150,7 @@ void ParameterMgr::initWLopParameter()
 	wLop.addParam(new RichDouble("Repulsion Power", 1.0));
 	wLop.addParam(new RichDouble("Average Power", 1.0));
 	wLop.addParam(new RichBool("Need Compute Density", true));
+	wLop.addParam(new RichBool("Persist Original Density", false));
 	wLop.addParam(new RichBool("Need Compute PCA", false));
 	wLop.addParam(new RichDouble("Repulsion Mu", 0.5));
 	wLop.addParam(new RichDouble("Repulsion Mu2", 0.0));
@@ -179,6 +173,7 @@ void ParameterMgr::initSkeletonParameter()
 	skeleton.addParam(new RichDouble("CGrid Radius", grid_r));
 	skeleton.addParam(new RichDouble("H Gaussian Para", 4));
 	skeleton.addParam(new RichBool("Need Compute Density", true));
+	skeleton.addParam(new RichBool("Persist Original Density", false));
 	
 	
 	skeleton.addParam(new RichDouble("Current Movement Error", 0.0));
@@ -196,12 +191,19 @@ void ParameterMgr::initSkeletonParameter()
 	//init
 	skeleton.addParam(new RichDouble("Max Iterate Time", 100));
 	skeleton.addParam(new RichDouble("Stop And Grow Error", 0.005));
+	skeleton.addParam(new RichDouble("Stop Error Percentile", 0)); // compare this percentile of the movements instead of the mean, 0 for mean
+	skeleton.addParam(new RichDouble("Freeze Move Epsilon", 0)); // 0 for never freezing samples
+	skeleton.addParam(new RichDouble("Freeze Still Iterations", 3));
 	skeleton.addParam(new RichDouble("Initial Radius", -1.));
 	skeleton.addParam(new RichDouble("Radius Update Speed", 0.2));
 
 	//step0
 	skeleton.addParam(new RichDouble("Repulsion Mu", 0.5));
 	skeleton.addParam(new RichDouble("Repulsion Mu2", 0.15));
+	skeleton.addParam(new RichDouble("Repulsion Opening Angle", 0.0)); // Barnes-Hut theta, 0 for exact repulsion
+	skeleton.addParam(new RichInt("Acceleration Mode", 0)); // 0 plain, 1 momentum, 2 anderson
+	skeleton.addParam(new RichDouble("Acceleration Momentum", 0.3));
+	skeleton.addParam(new RichDouble("Anderson Depth", 5));
 	skeleton.addParam(new RichDouble("Follow Sample Radius", 0.33));
 	skeleton.addParam(new RichDouble("Follow Sample Max Angle", 80));// should add to UI
 	skeleton.addParam(new RichDouble("Inactive And Keep Virtual Angle", 60)); // should add to UI
@@ -234,6 +236,8 @@ void ParameterMgr::initSkeletonParameter()
 	skeleton.addParam(new RichDouble("Fix Original Weight", 0.91));
 	skeleton.addParam(new RichDouble("Curve Segment Length", 0.05));
 	skeleton.addParam(new RichInt("Fix Original Mode", 4)); // 1 for noisy , 4 for clean
+	skeleton.addParam(new RichBool("Fuse Fix Original", true));
+	skeleton.addParam(new RichDouble("Local Density Radius", 0.0)); // 0 for 0.8 * CGrid Radius, used by fix mode 2
 
   skeleton.addParam(new RichBool("Run ALL Segment", false));
   skeleton.addParam(new RichBool("Need Segment Right Away", true));
@@ -37,7 +37,6 @@ public:
 	RichParameterSet upsampling;
 
 private:
-	static int init_time;
 	double grid_r;
 };
 
@@ -0,0 +1,795 @@
+#include "PointIO.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <omp.h>
+#include <pcl/io/lzf.h>
+
+using namespace std;
+
+namespace PointIO {
+
+MappedFile::MappedFile() : ptr(NULL), length(0) {}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+bool MappedFile::open(const std::string &filename) {
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if(p == MAP_FAILED)
+    return false;
+
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+  ptr = (const char *)p;
+  length = st.st_size;
+  return true;
+}
+
+void MappedFile::close() {
+  if(ptr != NULL)
+    munmap((void *)ptr, length);
+  ptr = NULL;
+  length = 0;
+}
+
+
+bool PCDHeader::parse(const char *data, size_t size, std::string &error) {
+  fields.clear();
+  width = height = points = 0;
+  point_step = 0;
+
+  vector<int> sizes, counts;
+  vector<char> types;
+  bool has_data = false;
+  size_t pos = 0;
+  while(pos < size) {
+    size_t end = pos;
+    while(end < size && data[end] != '\n')
+      end++;
+    string line(data + pos, end - pos);
+    pos = (end < size) ? end + 1 : end;
+
+    if(line.empty() || line[0] == '#')
+      continue;
+    if(line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+
+    istringstream in(line);
+    string key;
+    in >> key;
+    if(key == "FIELDS") {
+      string name;
+      while(in >> name) {
+        PCDField f;
+        f.name = name;
+        f.size = 4;
+        f.type = 'F';
+        f.count = 1;
+        f.offset = 0;
+        fields.push_back(f);
+      }
+    } else if(key == "SIZE") {
+      int s;
+      while(in >> s)
+        sizes.push_back(s);
+    } else if(key == "TYPE") {
+      char t;
+      while(in >> t)
+        types.push_back(t);
+    } else if(key == "COUNT") {
+      int c;
+      while(in >> c)
+        counts.push_back(c);
+    } else if(key == "WIDTH") {
+      in >> width;
+    } else if(key == "HEIGHT") {
+      in >> height;
+    } else if(key == "POINTS") {
+      in >> points;
+    } else if(key == "DATA") {
+      string type;
+      in >> type;
+      if(type == "ascii") {
+        data_type = ASCII;
+      } else if(type == "binary") {
+        data_type = BINARY;
+      } else if(type == "binary_compressed") {
+        data_type = BINARY_COMPRESSED;
+      } else {
+        error = "unknown DATA type " + type;
+        return false;
+      }
+      data_offset = pos;
+      has_data = true;
+      break;
+    }
+  }
+
+  if(!has_data) {
+    error = "no DATA line";
+    return false;
+  }
+  if(fields.empty() || sizes.size() != fields.size() || types.size() != fields.size() ||
+     (!counts.empty() && counts.size() != fields.size())) {
+    error = "FIELDS, SIZE, TYPE and COUNT do not match";
+    return false;
+  }
+
+  for(int i = 0; i < fields.size(); i++) {
+    fields[i].size = sizes[i];
+    fields[i].type = types[i];
+    fields[i].count = counts.empty() ? 1 : counts[i];
+    fields[i].offset = point_step;
+    point_step += fields[i].size * fields[i].count;
+  }
+  if(points == 0)
+    points = width * height;
+  return true;
+}
+
+int PCDHeader::find(const std::string &name) const {
+  for(int i = 0; i < fields.size(); i++)
+    if(fields[i].name == name)
+      return i;
+  return -1;
+}
+
+
+static inline float toFloat(const char *p, const PCDField &f) {
+  switch(f.type) {
+  case 'F':
+    if(f.size == 8) { double d; memcpy(&d, p, 8); return (float)d; }
+    { float v; memcpy(&v, p, 4); return v; }
+  case 'I':
+    if(f.size == 1) { signed char v; memcpy(&v, p, 1); return v; }
+    if(f.size == 2) { short v; memcpy(&v, p, 2); return v; }
+    if(f.size == 4) { int v; memcpy(&v, p, 4); return (float)v; }
+    { long long v; memcpy(&v, p, 8); return (float)v; }
+  default:
+    if(f.size == 1) { unsigned char v; memcpy(&v, p, 1); return v; }
+    if(f.size == 2) { unsigned short v; memcpy(&v, p, 2); return v; }
+    if(f.size == 4) { unsigned int v; memcpy(&v, p, 4); return (float)v; }
+    { unsigned long long v; memcpy(&v, p, 8); return (float)v; }
+  }
+}
+
+float readField(const char *p, const PCDField &f) {
+  return toFloat(p, f);
+}
+
+static inline void put(const FloatSink &sink, size_t i, float v) {
+  *(float *)(sink.base + i * sink.stride) = v;
+}
+
+static bool decodeASCII(const MappedFile &file, const PCDHeader &header,
+                        const vector<int> &index, const vector<FloatSink> &sinks,
+                        std::string &error) {
+  // token number of every field inside one line
+  vector<int> token(header.fields.size());
+  int tokens = 0;
+  for(int i = 0; i < header.fields.size(); i++) {
+    token[i] = tokens;
+    tokens += header.fields[i].count;
+  }
+
+  // the mapping is not null terminated, strtof needs a copy
+  string text(file.data() + header.data_offset, file.size() - header.data_offset);
+  const char *p = text.c_str();
+  for(size_t i = 0; i < header.points; i++) {
+    for(int t = 0; t < tokens; t++) {
+      char *end;
+      float v = strtof(p, &end);
+      if(end == p) {
+        ostringstream msg;
+        msg << "bad ascii value at point " << i;
+        error = msg.str();
+        return false;
+      }
+      p = end;
+      for(int k = 0; k < index.size(); k++)
+        if(token[index[k]] == t)
+          put(sinks[k], i, v);
+    }
+  }
+  return true;
+}
+
+bool decodePCD(const MappedFile &file, const PCDHeader &header,
+               const std::vector<std::string> &names,
+               const std::vector<FloatSink> &sinks, std::string &error) {
+  vector<int> index(names.size());
+  for(int k = 0; k < names.size(); k++) {
+    index[k] = header.find(names[k]);
+    if(index[k] < 0) {
+      error = "no field " + names[k];
+      return false;
+    }
+  }
+
+  long long n = header.points;
+  const char *body = file.data() + header.data_offset;
+  size_t body_size = file.size() - header.data_offset;
+
+  if(header.data_type == PCDHeader::ASCII)
+    return decodeASCII(file, header, index, sinks, error);
+
+  if(header.data_type == PCDHeader::BINARY) {
+    if(body_size < n * header.point_step) {
+      error = "binary data is truncated";
+      return false;
+    }
+    size_t step = header.point_step;
+#pragma omp parallel for schedule(static)
+    for(long long i = 0; i < n; i++) {
+      const char *pt = body + i * step;
+      for(int k = 0; k < index.size(); k++) {
+        const PCDField &f = header.fields[index[k]];
+        put(sinks[k], i, toFloat(pt + f.offset, f));
+      }
+    }
+    return true;
+  }
+
+  // binary_compressed: two sizes and one LZF block, the decompressed data holds
+  // every field as a column of all points
+  if(body_size < 8) {
+    error = "compressed data is truncated";
+    return false;
+  }
+  unsigned int compressed_size, uncompressed_size;
+  memcpy(&compressed_size, body, 4);
+  memcpy(&uncompressed_size, body + 4, 4);
+  if(body_size - 8 < compressed_size || uncompressed_size < n * header.point_step) {
+    error = "compressed data is truncated";
+    return false;
+  }
+
+  vector<char> buffer(uncompressed_size);
+  unsigned int got = pcl::lzfDecompress(body + 8, compressed_size, buffer.data(), uncompressed_size);
+  if(got != uncompressed_size) {
+    error = "LZF decompression failed";
+    return false;
+  }
+
+  for(int k = 0; k < index.size(); k++) {
+    const PCDField &f = header.fields[index[k]];
+    size_t column = 0;
+    for(int j = 0; j < index[k]; j++)
+      column += header.fields[j].size * header.fields[j].count * n;
+    const char *src = buffer.data() + column;
+    size_t elem = f.size * f.count;
+    const FloatSink &sink = sinks[k];
+#pragma omp parallel for schedule(static)
+    for(long long i = 0; i < n; i++)
+      put(sink, i, toFloat(src + i * elem, f));
+  }
+  return true;
+}
+
+static inline bool isSeparator(char c) {
+  return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+}
+
+static inline bool isDataLine(const char *p, const char *end) {
+  while(p < end && isSeparator(*p))
+    p++;
+  return p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.');
+}
+
+// the values of one line, at most max of them; returns the count
+static int parseLine(const char *p, const char *end, float *values, int max) {
+  int n = 0;
+  while(n < max) {
+    while(p < end && isSeparator(*p))
+      p++;
+    if(p < end && *p == '+')
+      p++;
+    if(p >= end)
+      break;
+    std::from_chars_result r = std::from_chars(p, end, values[n]);
+    if(r.ec != std::errc())
+      break;
+    p = r.ptr;
+    n++;
+  }
+  return n;
+}
+
+bool TextPoints::scan(const MappedFile &file, std::string &error) {
+  const char *data = file.data();
+  size_t size = file.size();
+  points = 0;
+  columns = 0;
+
+  // about 4 MB per chunk, at least a few per thread, each ends after a newline
+  size_t chunks = max<size_t>(size / (4 << 20), 4 * omp_get_max_threads());
+  chunks = min(chunks, max<size_t>(size / 1024, 1));
+  chunk_begin.assign(1, 0);
+  for(size_t c = 1; c < chunks; c++) {
+    size_t pos = max(size * c / chunks, chunk_begin.back());
+    const char *nl = (const char *)memchr(data + pos, '\n', size - pos);
+    if(nl == NULL)
+      break;
+    if(nl + 1 - data > chunk_begin.back())
+      chunk_begin.push_back(nl + 1 - data);
+  }
+  chunk_begin.push_back(size);
+  chunks = chunk_begin.size() - 1;
+
+  vector<size_t> counts(chunks, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+  for(long long c = 0; c < (long long)chunks; c++) {
+    const char *p = data + chunk_begin[c], *end = data + chunk_begin[c+1];
+    while(p < end) {
+      const char *nl = (const char *)memchr(p, '\n', end - p);
+      const char *line_end = nl ? nl : end;
+      if(isDataLine(p, line_end))
+        counts[c]++;
+      p = line_end + 1;
+    }
+  }
+
+  chunk_first.resize(chunks + 1);
+  for(size_t c = 0; c < chunks; c++) {
+    chunk_first[c] = points;
+    points += counts[c];
+  }
+  chunk_first[chunks] = points;
+
+  // the first point tells the column count
+  const char *p = data, *end = data + size;
+  while(p < end && columns == 0) {
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    const char *line_end = nl ? nl : end;
+    if(isDataLine(p, line_end)) {
+      float values[64];
+      columns = parseLine(p, line_end, values, 64);
+    }
+    p = line_end + 1;
+  }
+  if(points == 0)
+    error = "no points in the text";
+  return points > 0;
+}
+
+bool TextPoints::decode(const MappedFile &file, const std::vector<FloatSink> &sinks,
+                        std::string &error) const {
+  const char *data = file.data();
+  int want = sinks.size();
+  if(want > 64) {
+    error = "too many text columns";
+    return false;
+  }
+  long long chunks = chunk_begin.size() - 1;
+  long long bad_line = -1;
+
+#pragma omp parallel for schedule(dynamic, 1)
+  for(long long c = 0; c < chunks; c++) {
+    const char *p = data + chunk_begin[c], *end = data + chunk_begin[c+1];
+    size_t i = chunk_first[c];
+    float values[64];
+    while(p < end) {
+      const char *nl = (const char *)memchr(p, '\n', end - p);
+      const char *line_end = nl ? nl : end;
+      if(isDataLine(p, line_end)) {
+        if(parseLine(p, line_end, values, want) < want) {
+#pragma omp critical
+          if(bad_line < 0 || (long long)i < bad_line)
+            bad_line = i;
+          break;
+        }
+        for(int k = 0; k < want; k++)
+          if(sinks[k].base != NULL)
+            put(sinks[k], i, values[k]);
+        i++;
+      }
+      p = line_end + 1;
+    }
+  }
+
+  if(bad_line >= 0) {
+    ostringstream msg;
+    msg << "point " << bad_line << " has less than " << want << " values";
+    error = msg.str();
+    return false;
+  }
+  return true;
+}
+
+// PLY scalar type name to size and PCD type
+static bool plyType(const string &name, PCDField &f) {
+  static const char *names[] = { "char", "int8", "uchar", "uint8", "short", "int16",
+                                 "ushort", "uint16", "int", "int32", "uint", "uint32",
+                                 "float", "float32", "double", "float64" };
+  static const int sizes[] = { 1, 1, 1, 1, 2, 2, 2, 2, 4, 4, 4, 4, 4, 4, 8, 8 };
+  static const char types[] = "IIUUIIUUIIUUFFFF";
+  for(int i = 0; i < 16; i++)
+    if(name == names[i]) {
+      f.size = sizes[i];
+      f.type = types[i];
+      return true;
+    }
+  return false;
+}
+
+static const char *plyTypeName(const PCDField &f) {
+  if(f.type == 'F')
+    return f.size == 8 ? "double" : "float";
+  if(f.type == 'I')
+    return f.size == 1 ? "char" : (f.size == 2 ? "short" : "int");
+  return f.size == 1 ? "uchar" : (f.size == 2 ? "ushort" : "uint");
+}
+
+bool PLYHeader::parse(const char *data, size_t size, std::string &error) {
+  properties.clear();
+  vertices = vertex_step = data_offset = 0;
+
+  if(size < 4 || strncmp(data, "ply", 3) != 0) {
+    error = "not a PLY file";
+    return false;
+  }
+  bool binary = false, in_vertex = false, has_end = false;
+  size_t pos = 0;
+  while(pos < size) {
+    size_t end = pos;
+    while(end < size && data[end] != '\n')
+      end++;
+    string line(data + pos, end - pos);
+    pos = (end < size) ? end + 1 : end;
+    if(!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+
+    istringstream in(line);
+    string key;
+    in >> key;
+    if(key == "format") {
+      string format;
+      in >> format;
+      binary = format == "binary_little_endian";
+    } else if(key == "element") {
+      string name;
+      size_t count = 0;
+      in >> name >> count;
+      if(name == "vertex" && properties.empty() && vertices == 0) {
+        vertices = count;
+        in_vertex = true;
+      } else if(count > 0) {
+        error = "element " + name + " besides the vertices";
+        return false;
+      } else {
+        in_vertex = false;
+      }
+    } else if(key == "property") {
+      string type, name;
+      in >> type >> name;
+      if(!in_vertex)
+        continue;
+      PCDField f;
+      f.name = name;
+      f.count = 1;
+      f.offset = vertex_step;
+      if(!plyType(type, f)) {
+        error = "vertex property " + type + " " + name;
+        return false;
+      }
+      properties.push_back(f);
+      vertex_step += f.size;
+    } else if(key == "end_header") {
+      data_offset = pos;
+      has_end = true;
+      break;
+    }
+  }
+
+  if(!has_end) {
+    error = "no end_header";
+    return false;
+  }
+  if(!binary) {
+    error = "not binary_little_endian";
+    return false;
+  }
+  if(properties.empty()) {
+    error = "no vertex properties";
+    return false;
+  }
+  return true;
+}
+
+int PLYHeader::find(const std::string &name) const {
+  for(int i = 0; i < properties.size(); i++)
+    if(properties[i].name == name)
+      return i;
+  return -1;
+}
+
+bool decodePLY(const MappedFile &file, const PLYHeader &header,
+               const std::vector<std::string> &names,
+               const std::vector<FloatSink> &sinks, std::string &error) {
+  vector<int> index(names.size());
+  for(int k = 0; k < names.size(); k++) {
+    index[k] = header.find(names[k]);
+    if(index[k] < 0) {
+      error = "no property " + names[k];
+      return false;
+    }
+  }
+
+  long long n = header.vertices;
+  if(file.size() - header.data_offset < n * header.vertex_step) {
+    error = "vertex data is truncated";
+    return false;
+  }
+  const char *body = file.data() + header.data_offset;
+  size_t step = header.vertex_step;
+#pragma omp parallel for schedule(static)
+  for(long long i = 0; i < n; i++) {
+    const char *v = body + i * step;
+    for(int k = 0; k < index.size(); k++) {
+      const PCDField &f = header.properties[index[k]];
+      put(sinks[k], i, toFloat(v + f.offset, f));
+    }
+  }
+  return true;
+}
+
+// interleave one column per field into records of all fields
+static void interleave(const vector<PCDField> &fields, const vector<const char *> &columns,
+                       size_t points, vector<char> &records) {
+  vector<size_t> elem(fields.size());
+  size_t step = 0;
+  for(size_t k = 0; k < fields.size(); k++) {
+    elem[k] = fields[k].size * fields[k].count;
+    step += elem[k];
+  }
+  records.resize(step * points);
+  long long n = points;
+#pragma omp parallel for schedule(static)
+  for(long long i = 0; i < n; i++) {
+    char *dst = &records[i * step];
+    for(size_t k = 0; k < fields.size(); k++) {
+      memcpy(dst, columns[k] + i * elem[k], elem[k]);
+      dst += elem[k];
+    }
+  }
+}
+
+bool writePLY(const std::string &filename, const std::vector<PCDField> &fields,
+              const std::vector<const char *> &columns, size_t points, std::string &error) {
+  ostringstream header;
+  header << "ply\nformat binary_little_endian 1.0\nelement vertex " << points << "\n";
+  for(size_t k = 0; k < fields.size(); k++)
+    header << "property " << plyTypeName(fields[k]) << " " << fields[k].name << "\n";
+  header << "end_header\n";
+
+  vector<char> records;
+  interleave(fields, columns, points, records);
+
+  FILE *out = fopen(filename.c_str(), "wb");
+  if(out == NULL) {
+    error = "could not write " + filename;
+    return false;
+  }
+  string text = header.str();
+  bool ok = fwrite(text.data(), 1, text.size(), out) == text.size();
+  if(!records.empty())
+    ok = ok && fwrite(&records[0], 1, records.size(), out) == records.size();
+  if(fclose(out) != 0 || !ok) {
+    error = "could not write " + filename;
+    return false;
+  }
+  return true;
+}
+
+bool writePCD(const std::string &filename, const std::vector<PCDField> &fields,
+              const std::vector<const char *> &columns, size_t points, std::string &error) {
+  vector<size_t> elem(fields.size()), column_offset(fields.size());
+  size_t point_step = 0;
+  for(size_t k = 0; k < fields.size(); k++) {
+    elem[k] = fields[k].size * fields[k].count;
+    column_offset[k] = point_step * points;
+    point_step += elem[k];
+  }
+  size_t data_size = point_step * points;
+  if(data_size > 0xffffffffu) {
+    error = "too many points for one PCD block";
+    return false;
+  }
+
+  vector<char> raw(data_size);
+  for(size_t k = 0; k < fields.size(); k++)
+    if(data_size > 0)
+      memcpy(&raw[column_offset[k]], columns[k], elem[k] * points);
+
+  // LZF needs some slack for data that does not compress
+  vector<char> compressed(data_size + data_size / 16 + 64 + 8);
+  unsigned int compressed_size = 0;
+  if(data_size > 0)
+    compressed_size = pcl::lzfCompress(&raw[0], data_size, &compressed[8], compressed.size() - 8);
+  bool is_compressed = compressed_size > 0;
+
+  ostringstream header;
+  header << "# .PCD v0.7 - Point Cloud Data file format\nVERSION 0.7\nFIELDS";
+  for(size_t k = 0; k < fields.size(); k++)
+    header << " " << fields[k].name;
+  header << "\nSIZE";
+  for(size_t k = 0; k < fields.size(); k++)
+    header << " " << fields[k].size;
+  header << "\nTYPE";
+  for(size_t k = 0; k < fields.size(); k++)
+    header << " " << fields[k].type;
+  header << "\nCOUNT";
+  for(size_t k = 0; k < fields.size(); k++)
+    header << " " << fields[k].count;
+  header << "\nWIDTH " << points << "\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0\nPOINTS " << points
+         << "\nDATA " << (is_compressed ? "binary_compressed" : "binary") << "\n";
+
+  FILE *out = fopen(filename.c_str(), "wb");
+  if(out == NULL) {
+    error = "could not write " + filename;
+    return false;
+  }
+  string text = header.str();
+  bool ok = fwrite(text.data(), 1, text.size(), out) == text.size();
+  if(is_compressed) {
+    unsigned int sizes[2] = { compressed_size, (unsigned int)data_size };
+    memcpy(&compressed[0], sizes, 8);
+    ok = ok && fwrite(&compressed[0], 1, compressed_size + 8, out) == compressed_size + 8;
+  } else if(data_size > 0) {
+    vector<char> binary;
+    interleave(fields, columns, points, binary);
+    ok = ok && fwrite(&binary[0], 1, data_size, out) == data_size;
+  }
+  if(fclose(out) != 0 || !ok) {
+    error = "could not write " + filename;
+    return false;
+  }
+  return true;
+}
+
+
+static const char SKEL_MAGIC[8] = { 'S', 'K', 'E', 'L', 'B', 'I', 'N', '\0' };
+
+size_t skelTypeSize(uint32_t type) {
+  switch(type) {
+  case SKEL_F64: return 8;
+  case SKEL_U8: return 1;
+  default: return 4;
+  }
+}
+
+void SkelWriter::add(const std::string &name, SKEL_TYPE type, uint32_t components,
+                     uint64_t count, const void *data) {
+  SkelSection s;
+  memset(&s, 0, sizeof(s));
+  strncpy(s.name, name.c_str(), sizeof(s.name) - 1);
+  s.type = type;
+  s.components = components;
+  s.count = count;
+  s.offset = 0;
+  sections.push_back(s);
+
+  size_t bytes = skelTypeSize(type) * components * count;
+  payloads.push_back(vector<char>(bytes));
+  if(bytes > 0)
+    memcpy(&payloads.back()[0], data, bytes);
+}
+
+static inline uint64_t align(uint64_t offset) {
+  return (offset + SKEL_ALIGN - 1) / SKEL_ALIGN * SKEL_ALIGN;
+}
+
+bool SkelWriter::write(const std::string &filename, std::string &error) const {
+  vector<SkelSection> table = sections;
+  uint64_t offset = align(sizeof(SKEL_MAGIC) + 2 * sizeof(uint32_t) +
+                          table.size() * sizeof(SkelSection));
+  for(size_t i = 0; i < table.size(); i++) {
+    table[i].offset = offset;
+    offset = align(offset + payloads[i].size());
+  }
+
+  FILE *out = fopen(filename.c_str(), "wb");
+  if(out == NULL) {
+    error = "could not write " + filename;
+    return false;
+  }
+  uint32_t head[2] = { SKEL_VERSION, (uint32_t)table.size() };
+  bool ok = fwrite(SKEL_MAGIC, sizeof(SKEL_MAGIC), 1, out) == 1 &&
+            fwrite(head, sizeof(head), 1, out) == 1 &&
+            (table.empty() || fwrite(&table[0], sizeof(SkelSection), table.size(), out) == table.size());
+
+  static const char zeros[SKEL_ALIGN] = { 0 };
+  uint64_t pos = sizeof(SKEL_MAGIC) + sizeof(head) + table.size() * sizeof(SkelSection);
+  for(size_t i = 0; ok && i < table.size(); i++) {
+    ok = fwrite(zeros, 1, table[i].offset - pos, out) == table[i].offset - pos;
+    if(ok && !payloads[i].empty())
+      ok = fwrite(&payloads[i][0], 1, payloads[i].size(), out) == payloads[i].size();
+    pos = table[i].offset + payloads[i].size();
+  }
+  if(fclose(out) != 0 || !ok) {
+    error = "could not write " + filename;
+    return false;
+  }
+  return true;
+}
+
+bool SkelReader::open(const std::string &filename, std::string &error) {
+  sections.clear();
+  if(!file.open(filename)) {
+    error = "could not map " + filename;
+    return false;
+  }
+
+  size_t head = sizeof(SKEL_MAGIC) + 2 * sizeof(uint32_t);
+  if(file.size() < head || memcmp(file.data(), SKEL_MAGIC, sizeof(SKEL_MAGIC)) != 0) {
+    error = filename + " is not a binary skeleton file";
+    return false;
+  }
+  uint32_t count;
+  memcpy(&version, file.data() + sizeof(SKEL_MAGIC), sizeof(uint32_t));
+  memcpy(&count, file.data() + sizeof(SKEL_MAGIC) + sizeof(uint32_t), sizeof(uint32_t));
+  if(version > SKEL_VERSION) {
+    error = "unsupported binary skeleton version";
+    return false;
+  }
+  if(file.size() < head + (size_t)count * sizeof(SkelSection)) {
+    error = "section table is truncated";
+    return false;
+  }
+
+  sections.resize(count);
+  if(count > 0)
+    memcpy(&sections[0], file.data() + head, count * sizeof(SkelSection));
+  for(size_t i = 0; i < sections.size(); i++) {
+    SkelSection &s = sections[i];
+    s.name[sizeof(s.name) - 1] = '\0';
+    uint64_t bytes = skelTypeSize(s.type) * s.components * s.count;
+    if(s.offset > file.size() || bytes > file.size() - s.offset) {
+      error = string("section ") + s.name + " is truncated";
+      sections.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+const SkelSection *SkelReader::find(const std::string &name) const {
+  for(size_t i = 0; i < sections.size(); i++)
+    if(name == sections[i].name)
+      return &sections[i];
+  return NULL;
+}
+
+const SkelSection *SkelReader::find(const std::string &name, SKEL_TYPE type,
+                                    uint32_t components) const {
+  const SkelSection *s = find(name);
+  if(s == NULL || s->type != type || s->components != components)
+    return NULL;
+  return s;
+}
+
+}
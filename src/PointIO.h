@@ -0,0 +1,192 @@
+#ifndef POINT_IO_H
+#define POINT_IO_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Low level point cloud file access used by DataMgr. Files are memory mapped
+// and the fields are decoded straight into the caller's arrays, described as
+// strided sinks, without an intermediate cloud.
+namespace PointIO {
+
+// Read only memory mapping of a whole file.
+class MappedFile {
+  public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string &filename);
+    void close();
+
+    const char *data() const { return ptr; }
+    size_t size() const { return length; }
+
+  private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const char *ptr;
+    size_t length;
+};
+
+// Destination of one float component: element i is written to
+// *(float *)(base + i * stride). A component of the CVertex array is
+// FloatSink((char *)&vert[0].P()[0], sizeof(CVertex)).
+struct FloatSink {
+  FloatSink() : base(NULL), stride(0) {}
+  FloatSink(char *_base, size_t _stride) : base(_base), stride(_stride) {}
+  char *base;
+  size_t stride;
+};
+
+struct PCDField {
+  std::string name;
+  int size;     // bytes of one element
+  char type;    // 'F', 'I' or 'U'
+  int count;    // elements per point
+  int offset;   // byte offset inside a binary point
+};
+
+class PCDHeader {
+  public:
+    enum DATA_TYPE { ASCII, BINARY, BINARY_COMPRESSED };
+
+    std::vector<PCDField> fields;
+    size_t width, height, points;
+    size_t point_step;
+    DATA_TYPE data_type;
+    size_t data_offset;   // first byte after the DATA line
+
+    // parse the header at the start of a mapped file, error says what is wrong
+    bool parse(const char *data, size_t size, std::string &error);
+    // index of the field or -1
+    int find(const std::string &name) const;
+};
+
+// value of one element of a field as a float, p points at the element
+float readField(const char *p, const PCDField &f);
+
+// Decode the first component of the named fields into the sinks, one sink per
+// name. All names must exist in the header. Binary data is decoded in
+// parallel; binary_compressed is decompressed once and its field columns are
+// then scattered in parallel.
+bool decodePCD(const MappedFile &file, const PCDHeader &header,
+               const std::vector<std::string> &names,
+               const std::vector<FloatSink> &sinks, std::string &error);
+
+// Header of a vertex only binary_little_endian PLY (the point clouds we write
+// and most scanners export). parse() fails for anything else (ascii, big
+// endian, faces or list properties), the caller then uses plylib instead.
+// Properties are described as PCD fields with their offset in a vertex.
+class PLYHeader {
+  public:
+    std::vector<PCDField> properties;
+    size_t vertices;
+    size_t vertex_step;
+    size_t data_offset;   // first byte after end_header
+
+    bool parse(const char *data, size_t size, std::string &error);
+    // index of the property or -1
+    int find(const std::string &name) const;
+};
+
+// as decodePCD, the vertices are decoded in parallel from the mapping
+bool decodePLY(const MappedFile &file, const PLYHeader &header,
+               const std::vector<std::string> &names,
+               const std::vector<FloatSink> &sinks, std::string &error);
+
+// Write a vertex only binary_little_endian PLY from one column per property,
+// laid out as for writePCD.
+bool writePLY(const std::string &filename, const std::vector<PCDField> &fields,
+              const std::vector<const char *> &columns, size_t points, std::string &error);
+
+// Whitespace (or comma) separated text with one point per line, as in .xyz,
+// .xyzn and .txt exports. scan() cuts the mapping into line aligned chunks
+// and counts the points of every chunk in parallel, so the caller can size
+// its arrays before decode() parses the chunks in parallel with
+// std::from_chars. Empty lines and lines not starting with a number (headers,
+// comments) are skipped.
+class TextPoints {
+  public:
+    TextPoints() : points(0), columns(0) {}
+
+    bool scan(const MappedFile &file, std::string &error);
+    // column k of every point goes to sinks[k], sinks with a NULL base are
+    // skipped; every point needs at least sinks.size() columns
+    bool decode(const MappedFile &file, const std::vector<FloatSink> &sinks,
+                std::string &error) const;
+
+    size_t points;
+    int columns;    // columns of the first point
+
+  private:
+    std::vector<size_t> chunk_begin;   // chunk c is [chunk_begin[c], chunk_begin[c+1])
+    std::vector<size_t> chunk_first;   // index of the first point of every chunk
+};
+
+// Write a PCD file from one column per field: column k holds points values
+// of fields[k] (size * count bytes each, offsets are ignored). The columns
+// are exactly the layout of binary_compressed data, which is written unless
+// LZF cannot shrink it; then the points are interleaved as binary data.
+bool writePCD(const std::string &filename, const std::vector<PCDField> &fields,
+              const std::vector<const char *> &columns, size_t points, std::string &error);
+
+// Binary skeleton file (.skelb): a header, a table of named, typed sections
+// and the section data, every section aligned to SKEL_ALIGN bytes. A reader
+// maps the file and uses the sections in place, so only the pages of the
+// sections actually read are loaded. Values are little endian.
+//
+//   "SKELBIN\0", uint32 version, uint32 section count,
+//   SkelSection[count], data
+enum SKEL_TYPE { SKEL_F32 = 0, SKEL_F64 = 1, SKEL_I32 = 2, SKEL_U32 = 3, SKEL_U8 = 4 };
+
+const uint32_t SKEL_VERSION = 1;
+const size_t SKEL_ALIGN = 64;
+
+struct SkelSection {
+  char name[32];        // null terminated, e.g. "sample.position"
+  uint32_t type;        // SKEL_TYPE
+  uint32_t components;  // values per element, 3 for a position
+  uint64_t count;       // elements
+  uint64_t offset;      // from the start of the file
+};
+
+size_t skelTypeSize(uint32_t type);
+
+// Collects sections and writes them in one go; the data is copied on add.
+class SkelWriter {
+  public:
+    void add(const std::string &name, SKEL_TYPE type, uint32_t components,
+             uint64_t count, const void *data);
+    bool write(const std::string &filename, std::string &error) const;
+
+  private:
+    std::vector<SkelSection> sections;
+    std::vector<std::vector<char> > payloads;
+};
+
+class SkelReader {
+  public:
+    bool open(const std::string &filename, std::string &error);
+
+    // the section or NULL, data points into the mapping
+    const SkelSection *find(const std::string &name) const;
+    const void *data(const SkelSection &section) const { return file.data() + section.offset; }
+
+    // the section if it exists with the given type and components
+    const SkelSection *find(const std::string &name, SKEL_TYPE type, uint32_t components) const;
+
+    const std::vector<SkelSection> &getSections() const { return sections; }
+    uint32_t getVersion() const { return version; }
+
+  private:
+    MappedFile file;
+    std::vector<SkelSection> sections;
+    uint32_t version;
+};
+
+}
+
+#endif
@@ -0,0 +1,247 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <utility>
+using namespace std;
+
+namespace Profiler {
+
+struct Event {
+  int section;
+  int thread;
+  double start;     // microseconds since the epoch of the profiler
+  double duration;  // microseconds
+};
+
+// open sections of one thread, -1 for those opened while disabled
+struct ThreadStack {
+  ThreadStack() : thread(-1) {}
+  vector<pair<int, double> > open;
+  int thread;
+};
+
+static atomic<bool> enabled(false);
+static mutex events_mutex;
+static const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+static vector<string> paths;
+static vector<string> names;
+static map<pair<int, string>, int> children;  // (parent, name) -> section
+static vector<Event> events;
+static int thread_count = 0;
+static thread_local ThreadStack thread_stack;
+
+static double now() {
+  return chrono::duration<double, micro>(chrono::steady_clock::now() - epoch).count();
+}
+
+void setEnabled(bool on) {
+  enabled = on;
+}
+
+bool isEnabled() {
+  return enabled;
+}
+
+void begin(const std::string &name) {
+  if(!enabled) {
+    thread_stack.open.push_back(make_pair(-1, 0.0));
+    return;
+  }
+
+  int parent = -1;
+  for(size_t i = thread_stack.open.size(); i > 0; i--)
+    if(thread_stack.open[i-1].first >= 0) {
+      parent = thread_stack.open[i-1].first;
+      break;
+    }
+
+  int section;
+  {
+    lock_guard<mutex> guard(events_mutex);
+    if(thread_stack.thread < 0)
+      thread_stack.thread = thread_count++;
+    map<pair<int, string>, int>::iterator it = children.find(make_pair(parent, name));
+    if(it == children.end()) {
+      section = paths.size();
+      paths.push_back(parent < 0 ? name : paths[parent] + "/" + name);
+      names.push_back(name);
+      children[make_pair(parent, name)] = section;
+    } else {
+      section = it->second;
+    }
+  }
+  thread_stack.open.push_back(make_pair(section, now()));
+}
+
+void end() {
+  if(thread_stack.open.empty())
+    return;
+  pair<int, double> section = thread_stack.open.back();
+  thread_stack.open.pop_back();
+  if(section.first < 0)
+    return;
+
+  Event e;
+  e.section = section.first;
+  e.thread = thread_stack.thread;
+  e.start = section.second;
+  e.duration = now() - section.second;
+  lock_guard<mutex> guard(events_mutex);
+  events.push_back(e);
+}
+
+// nearest rank percentile of sorted values
+static double percentile(const vector<double> &sorted, double p) {
+  size_t rank = (size_t)ceil(p * sorted.size());
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+std::vector<Stat> summary() {
+  vector<vector<double> > durations;
+  vector<string> section_paths;
+  {
+    lock_guard<mutex> guard(events_mutex);
+    section_paths = paths;
+    durations.resize(paths.size());
+    for(size_t i = 0; i < events.size(); i++)
+      durations[events[i].section].push_back(events[i].duration * 1e-6);
+  }
+
+  vector<Stat> stats;
+  for(size_t s = 0; s < durations.size(); s++) {
+    vector<double> &d = durations[s];
+    if(d.empty())
+      continue;
+    sort(d.begin(), d.end());
+    Stat stat;
+    stat.path = section_paths[s];
+    stat.count = d.size();
+    stat.total = 0;
+    for(size_t i = 0; i < d.size(); i++)
+      stat.total += d[i];
+    stat.mean = stat.total / d.size();
+    stat.min = d.front();
+    stat.p50 = percentile(d, 0.5);
+    stat.p90 = percentile(d, 0.9);
+    stat.p99 = percentile(d, 0.99);
+    stat.max = d.back();
+    stats.push_back(stat);
+  }
+
+  // '/' sorts before every other character, which puts children right after
+  // their parent
+  sort(stats.begin(), stats.end(), [](const Stat &a, const Stat &b) {
+    string ka = a.path, kb = b.path;
+    replace(ka.begin(), ka.end(), '/', '\1');
+    replace(kb.begin(), kb.end(), '/', '\1');
+    return ka < kb;
+  });
+  return stats;
+}
+
+void print(std::ostream &out) {
+  vector<Stat> stats = summary();
+  out << left << setw(56) << "section" << right << setw(8) << "count" << setw(12) << "total s"
+      << setw(12) << "mean ms" << setw(12) << "p50 ms" << setw(12) << "p90 ms" << setw(12)
+      << "p99 ms" << setw(12) << "max ms" << endl;
+  out << fixed << setprecision(3);
+  for(size_t i = 0; i < stats.size(); i++) {
+    const Stat &s = stats[i];
+    // indent by depth and show only the last name of the path
+    size_t depth = count(s.path.begin(), s.path.end(), '/');
+    size_t slash = s.path.rfind('/');
+    string label = string(2 * depth, ' ') + s.path.substr(slash == string::npos ? 0 : slash + 1);
+    out << left << setw(56) << label << right << setw(8) << s.count << setw(12) << s.total
+        << setw(12) << 1e3 * s.mean << setw(12) << 1e3 * s.p50 << setw(12) << 1e3 * s.p90
+        << setw(12) << 1e3 * s.p99 << setw(12) << 1e3 * s.max << endl;
+  }
+  out.unsetf(ios::floatfield);
+}
+
+static string quote(const string &s) {
+  string q = "\"";
+  for(size_t i = 0; i < s.size(); i++) {
+    char c = s[i];
+    if(c == '"' || c == '\\') {
+      q += '\\';
+      q += c;
+    } else if((unsigned char)c < 0x20) {
+      char code[8];
+      snprintf(code, sizeof(code), "\\u%04x", c);
+      q += code;
+    } else {
+      q += c;
+    }
+  }
+  return q + "\"";
+}
+
+static FILE *openOutput(const std::string &filename, std::string &error) {
+  FILE *out = fopen(filename.c_str(), "w");
+  if(out == NULL)
+    error = "could not open " + filename + " for writing";
+  return out;
+}
+
+bool writeJSON(const std::string &filename, std::string &error) {
+  vector<Stat> stats = summary();
+  FILE *out = openOutput(filename, error);
+  if(out == NULL)
+    return false;
+  fprintf(out, "{\"sections\": [\n");
+  for(size_t i = 0; i < stats.size(); i++) {
+    const Stat &s = stats[i];
+    fprintf(out, "  {\"path\": %s, \"count\": %zu, \"total_ms\": %.3f, \"mean_ms\": %.3f, "
+            "\"min_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, "
+            "\"max_ms\": %.3f}%s\n", quote(s.path).c_str(), s.count, 1e3 * s.total,
+            1e3 * s.mean, 1e3 * s.min, 1e3 * s.p50, 1e3 * s.p90, 1e3 * s.p99, 1e3 * s.max,
+            i + 1 < stats.size() ? "," : "");
+  }
+  fprintf(out, "]}\n");
+  bool ok = fclose(out) == 0;
+  if(!ok)
+    error = "could not write " + filename;
+  return ok;
+}
+
+bool writeChromeTrace(const std::string &filename, std::string &error) {
+  vector<Event> trace;
+  vector<string> section_paths, section_names;
+  {
+    lock_guard<mutex> guard(events_mutex);
+    trace = events;
+    section_paths = paths;
+    section_names = names;
+  }
+  FILE *out = openOutput(filename, error);
+  if(out == NULL)
+    return false;
+  fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  for(size_t i = 0; i < trace.size(); i++) {
+    const Event &e = trace[i];
+    fprintf(out, "  {\"name\": %s, \"cat\": \"skeleton\", \"ph\": \"X\", \"ts\": %.1f, "
+            "\"dur\": %.1f, \"pid\": 1, \"tid\": %d, \"args\": {\"path\": %s}}%s\n",
+            quote(section_names[e.section]).c_str(), e.start, e.duration, e.thread,
+            quote(section_paths[e.section]).c_str(), i + 1 < trace.size() ? "," : "");
+  }
+  fprintf(out, "]}\n");
+  bool ok = fclose(out) == 0;
+  if(!ok)
+    error = "could not write " + filename;
+  return ok;
+}
+
+void clear() {
+  lock_guard<mutex> guard(events_mutex);
+  events.clear();
+}
+
+}
@@ -0,0 +1,67 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Wall-clock profiler of nested sections. A section opened while another is
+// open on the same thread becomes its child, so every section is known by its
+// path ("run_full/runStep0/wlopIterate/computeAverageTerm"). Every closed
+// section is kept as an event, which gives the totals, counts and percentiles
+// of every path over all iterations and a Chrome trace (chrome://tracing,
+// Perfetto) of the whole run. Sections cost nothing while it is disabled.
+namespace Profiler {
+
+void setEnabled(bool enabled);
+bool isEnabled();
+
+// open a section below the innermost open section of this thread, and close
+// the innermost one
+void begin(const std::string &name);
+void end();
+
+// a section for the lifetime of the object
+class Scope {
+  public:
+    explicit Scope(const char *name) : active(isEnabled()) {
+      if(active)
+        begin(name);
+    }
+    ~Scope() {
+      if(active)
+        end();
+    }
+
+  private:
+    Scope(const Scope &);
+    Scope &operator=(const Scope &);
+
+    bool active;
+};
+
+// seconds spent in one path over all its events
+struct Stat {
+  std::string path;
+  size_t count;
+  double total, mean, min, p50, p90, p99, max;
+};
+
+// one Stat per path, parents before their children
+std::vector<Stat> summary();
+
+// the summary as a table
+void print(std::ostream &out);
+
+// the summary as {"sections": [...]}, times in milliseconds
+bool writeJSON(const std::string &filename, std::string &error);
+
+// every event in the Chrome trace event format
+bool writeChromeTrace(const std::string &filename, std::string &error);
+
+// drop all events, open sections stay open
+void clear();
+
+}
+
+#endif
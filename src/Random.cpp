@@ -0,0 +1,56 @@
+#include "Random.h"
+
+#include <atomic>
+#include <ctime>
+
+namespace Random {
+
+static std::atomic<uint64_t> seed((uint64_t)time(NULL));
+// bumped by setSeed, so the thread generators notice the new seed
+static std::atomic<unsigned int> seed_version(0);
+
+struct ThreadGenerator {
+  ThreadGenerator() : version(-1) {}
+  Generator generator;
+  long long version;
+};
+
+static thread_local ThreadGenerator thread_generator;
+
+void setSeed(uint64_t s) {
+  seed = s;
+  seed_version++;
+}
+
+uint64_t getSeed() {
+  return seed;
+}
+
+Generator stream(uint64_t key) {
+  // two rounds of splitmix64 decorrelate neighboring keys
+  Generator mix(seed ^ (key * 0xd1342543de82ef95ULL));
+  mix.next();
+  return Generator(mix.next());
+}
+
+Generator &local() {
+  if(thread_generator.version != seed_version)
+    restart(0);
+  return thread_generator.generator;
+}
+
+void restart(uint64_t key) {
+  thread_generator.generator = stream(key);
+  thread_generator.version = seed_version;
+}
+
+uint64_t key(const std::string &name) {
+  uint64_t hash = 14695981039346656037ULL;
+  for(size_t i = 0; i < name.size(); i++) {
+    hash ^= (unsigned char)name[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+}
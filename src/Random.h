@@ -0,0 +1,69 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+#include <string>
+
+// Seedable random numbers. Every run has one seed, from the clock unless
+// setSeed was called, and every random decision draws from a splitmix64
+// generator derived from it:
+// - sequential code uses the generator of its thread, which a worker
+//   restarts with the key of its job (the index of the file or component),
+//   so a job draws the same numbers whichever thread runs it;
+// - parallel loops take stream(key) with the index of their element, so the
+//   result does not depend on the number of threads either.
+namespace Random {
+
+class Generator {
+  public:
+    typedef uint64_t result_type;
+
+    explicit Generator(uint64_t seed = 0) : state(seed) {}
+
+    uint64_t next() {
+      uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+
+    // uniform in [0, 1)
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // uniform in [0, n), n > 0
+    uint64_t below(uint64_t n) {
+      // reject the top values that would favor the small results
+      uint64_t limit = UINT64_MAX - UINT64_MAX % n;
+      uint64_t r;
+      do {
+        r = next();
+      } while(r >= limit);
+      return r % n;
+    }
+
+    // UniformRandomBitGenerator, for std::shuffle and the distributions
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return UINT64_MAX; }
+    uint64_t operator()() { return next(); }
+
+  private:
+    uint64_t state;
+};
+
+void setSeed(uint64_t seed);
+uint64_t getSeed();
+
+// the generator of the calling thread, at the stream of key 0 until restarted
+Generator &local();
+// start the generator of the calling thread at the stream of key
+void restart(uint64_t key);
+
+// the generator for key under the run seed, independent of any thread
+Generator stream(uint64_t key);
+
+// a key for things known by name, FNV-1a
+uint64_t key(const std::string &name);
+
+}
+
+#endif
@@ -0,0 +1,326 @@
+#include "Sampler.h"
+#include "GlobalFunction.h"
+#include "grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+using namespace std;
+using namespace vcg;
+
+namespace Sampler {
+
+int methodFromName(const std::string &name) {
+  if(name == "random") return RANDOM;
+  if(name == "ordered") return ORDERED;
+  if(name == "voxel") return VOXEL;
+  if(name == "poisson") return POISSON;
+  if(name == "fps") return FPS;
+  return -1;
+}
+
+std::vector<int> select(int method, std::vector<CVertex> &vert, Box3f box, int want) {
+  if(want > vert.size())
+    want = vert.size();
+
+  switch(method) {
+  case ORDERED: {
+    vector<int> index(want);
+    for(int i = 0; i < want; i++)
+      index[i] = i;
+    return index;
+  }
+  case VOXEL:
+    return voxel(vert, box, want);
+  case POISSON:
+    return poissonDisk(vert, box, want);
+  case FPS:
+    return farthestPoint(vert, box, want);
+  default:
+    return random(vert, want);
+  }
+}
+
+std::vector<int> random(std::vector<CVertex> &vert, int want) {
+  vector<int> index = GlobalFun::GetRandomCards(vert.size());
+  if(want < index.size())
+    index.resize(want);
+  return index;
+}
+
+// keep want of the given indices, picked at random, if there are more
+static void trim(vector<int> &index, int want) {
+  if(index.size() <= want)
+    return;
+  vector<int> cards = GlobalFun::GetRandomCards(index.size());
+  vector<int> kept(want);
+  for(int i = 0; i < want; i++)
+    kept[i] = index[cards[i]];
+  index.swap(kept);
+}
+
+// 21 bits per axis
+static const int KEY_BITS = 21;
+static const double KEY_MAX = (1 << KEY_BITS) - 1;
+
+static inline unsigned long long voxelKey(const Point3f &p, const Box3f &box, double size) {
+  unsigned long long key = 0;
+  for(int i = 0; i < 3; i++) {
+    double c = floor((p[i] - box.min[i]) / size);
+    c = c < 0 ? 0 : (c > KEY_MAX ? KEY_MAX : c);
+    key = (key << KEY_BITS) | (unsigned long long)c;
+  }
+  return key;
+}
+
+// (key, index) of every point, sorted by key
+static void voxelize(vector<CVertex> &vert, const Box3f &box, double size,
+                     vector<pair<unsigned long long, int> > &keys) {
+  keys.resize(vert.size());
+  long long n = vert.size();
+#pragma omp parallel for schedule(static)
+  for(long long i = 0; i < n; i++)
+    keys[i] = make_pair(voxelKey(vert[i].P(), box, size), (int)i);
+  sort(keys.begin(), keys.end());
+}
+
+static int countVoxels(const vector<pair<unsigned long long, int> > &keys) {
+  int count = 0;
+  for(size_t i = 0; i < keys.size(); i++)
+    if(i == 0 || keys[i].first != keys[i-1].first)
+      count++;
+  return count;
+}
+
+// The occupied voxel count goes like size^-d, d = 2 on a surface and 3 in a
+// volume. Start from the surface guess and correct d from the last two tries.
+static double searchVoxelSize(vector<CVertex> &vert, const Box3f &box, int want,
+                              vector<pair<unsigned long long, int> > &keys) {
+  double diag = box.Diag();
+  double min_size = diag / KEY_MAX;
+  double size = diag / sqrt((double)want);
+  double d = 2.0;
+  double last_size = -1, last_count = -1;
+
+  for(int iter = 0; iter < 8; iter++) {
+    voxelize(vert, box, size, keys);
+    double count = countVoxels(keys);
+    if(count >= want && count <= 1.25 * want)
+      break;
+    if(last_count > 0 && count != last_count && size != last_size) {
+      double e = -log(count / last_count) / log(size / last_size);
+      d = e < 1 ? 1 : (e > 3 ? 3 : e);
+    }
+    last_size = size;
+    last_count = count;
+    // aim a bit above want, trimming is cheaper than another pass
+    size *= pow(count / (1.1 * want), 1.0 / d);
+    if(size < min_size)
+      size = min_size;
+  }
+  return size;
+}
+
+std::vector<int> voxel(std::vector<CVertex> &vert, Box3f box, int want) {
+  vector<int> index;
+  if(want <= 0 || vert.empty())
+    return index;
+  if(want >= vert.size())
+    return random(vert, want);
+
+  vector<pair<unsigned long long, int> > keys;
+  double size = searchVoxelSize(vert, box, want, keys);
+
+  vector<int> starts;
+  for(size_t i = 0; i < keys.size(); i++)
+    if(i == 0 || keys[i].first != keys[i-1].first)
+      starts.push_back(i);
+  starts.push_back(keys.size());
+
+  int voxel_num = starts.size() - 1;
+  index.resize(voxel_num);
+#pragma omp parallel for schedule(dynamic, 256)
+  for(int v = 0; v < voxel_num; v++) {
+    const Point3f &first = vert[keys[starts[v]].second].P();
+    Point3f center;
+    for(int i = 0; i < 3; i++)
+      center[i] = box.min[i] + (floor((first[i] - box.min[i]) / size) + 0.5) * size;
+
+    int best = keys[starts[v]].second;
+    double best_dist2 = (vert[best].P() - center).SquaredNorm();
+    for(int k = starts[v] + 1; k < starts[v+1]; k++) {
+      int i = keys[k].second;
+      double dist2 = (vert[i].P() - center).SquaredNorm();
+      if(dist2 < best_dist2) {
+        best = i;
+        best_dist2 = dist2;
+      }
+    }
+    index[v] = best;
+  }
+
+  trim(index, want);
+  return index;
+}
+
+// One pass of dart throwing with the given radius. Cells of the same phase
+// (x%3, y%3, z%3) are at least two cells apart, so their 27 neighborhoods only
+// share cells that neither of them writes and a phase runs in parallel.
+static void throwDarts(vector<CVertex> &vert, Box3f &box, double radius, vector<int> &index) {
+  // keep the cell count in check, larger cells still cover the radius
+  double cell_size = radius;
+  Point3f ext = box.max - box.min;
+  double limit = 8.0 * vert.size() + 64;
+  while((ceil(ext[0] / cell_size) + 1) * (ceil(ext[1] / cell_size) + 1) *
+        (ceil(ext[2] / cell_size) + 1) > limit)
+    cell_size *= 1.5;
+
+  CGrid grid;
+  grid.init(vert, box, cell_size);
+
+  vector<vector<CVertex *> > accepted(grid.xside * grid.yside * grid.zside);
+  double radius2 = radius * radius;
+
+  for(int phase = 0; phase < 27; phase++) {
+    int px = phase % 3, py = (phase / 3) % 3, pz = phase / 9;
+    int nx = (grid.xside - px + 2) / 3;
+    int ny = (grid.yside - py + 2) / 3;
+    int nz = (grid.zside - pz + 2) / 3;
+    int phase_cells = nx * ny * nz;
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for(int c = 0; c < phase_cells; c++) {
+      int x = px + 3 * (c % nx);
+      int y = py + 3 * ((c / nx) % ny);
+      int z = pz + 3 * (c / (nx * ny));
+      int origin = grid.cell(x, y, z);
+      if(grid.isEmpty(origin))
+        continue;
+
+      // the points in a cell are sorted along x, take them in a scattered order
+      vector<CVertex *> candidates(grid.startV(origin), grid.endV(origin));
+      for(size_t k = candidates.size(); k > 1; k--)
+        swap(candidates[k-1], candidates[(k * 2654435761u + origin) % k]);
+
+      for(size_t k = 0; k < candidates.size(); k++) {
+        const Point3f &p = candidates[k]->P();
+        bool free = true;
+        for(int dz = -1; dz <= 1 && free; dz++) {
+          if(z + dz < 0 || z + dz >= grid.zside) continue;
+          for(int dy = -1; dy <= 1 && free; dy++) {
+            if(y + dy < 0 || y + dy >= grid.yside) continue;
+            for(int dx = -1; dx <= 1 && free; dx++) {
+              if(x + dx < 0 || x + dx >= grid.xside) continue;
+              vector<CVertex *> &near = accepted[grid.cell(x + dx, y + dy, z + dz)];
+              for(size_t j = 0; j < near.size(); j++) {
+                if((p - near[j]->P()).SquaredNorm() < radius2) {
+                  free = false;
+                  break;
+                }
+              }
+            }
+          }
+        }
+        if(free)
+          accepted[origin].push_back(candidates[k]);
+      }
+    }
+  }
+
+  index.clear();
+  CVertex *first = &vert[0];
+  for(size_t c = 0; c < accepted.size(); c++)
+    for(size_t j = 0; j < accepted[c].size(); j++)
+      index.push_back(accepted[c][j] - first);
+}
+
+std::vector<int> poissonDisk(std::vector<CVertex> &vert, Box3f box, int want) {
+  vector<int> index;
+  if(want <= 0 || vert.empty())
+    return index;
+  if(want >= vert.size())
+    return random(vert, want);
+
+  // the voxel size giving about want voxels is a good first radius
+  vector<pair<unsigned long long, int> > keys;
+  double radius = searchVoxelSize(vert, box, want, keys);
+  keys.clear();
+
+  double d = 2.0;
+  double last_radius = -1, last_count = -1;
+  for(int iter = 0; iter < 6; iter++) {
+    throwDarts(vert, box, radius, index);
+    double count = index.size();
+    if(count >= want && count <= 1.25 * want)
+      break;
+    if(last_count > 0 && count != last_count && radius != last_radius) {
+      double e = -log(count / last_count) / log(radius / last_radius);
+      d = e < 1 ? 1 : (e > 3 ? 3 : e);
+    }
+    last_radius = radius;
+    last_count = count;
+    radius *= pow(count / (1.1 * want), 1.0 / d);
+  }
+
+  trim(index, want);
+  return index;
+}
+
+std::vector<int> farthestPoint(std::vector<CVertex> &vert, Box3f box, int want) {
+  if(want <= 0 || vert.empty())
+    return vector<int>();
+
+  vector<int> candidates = voxel(vert, box, 4 * want);
+  if(candidates.size() <= want)
+    return candidates;
+
+  long long m = candidates.size();
+  vector<double> dist2(m, GlobalFun::getDoubleMAXIMUM());
+  vector<int> index;
+  index.reserve(want);
+
+  // start from the candidate nearest to the box center
+  Point3f center = box.Center();
+  int next = 0;
+  for(long long k = 1; k < m; k++)
+    if((vert[candidates[k]].P() - center).SquaredNorm() <
+       (vert[candidates[next]].P() - center).SquaredNorm())
+      next = k;
+
+  while(index.size() < want) {
+    index.push_back(candidates[next]);
+    Point3f p = vert[candidates[next]].P();
+
+    double best = -1;
+    int best_k = -1;
+#pragma omp parallel
+    {
+      double local_best = -1;
+      int local_k = -1;
+#pragma omp for schedule(static) nowait
+      for(long long k = 0; k < m; k++) {
+        double d = (vert[candidates[k]].P() - p).SquaredNorm();
+        if(d < dist2[k])
+          dist2[k] = d;
+        if(dist2[k] > local_best) {
+          local_best = dist2[k];
+          local_k = k;
+        }
+      }
+#pragma omp critical
+      {
+        if(local_best > best || (local_best == best && local_k < best_k)) {
+          best = local_best;
+          best_k = local_k;
+        }
+      }
+    }
+    if(best_k < 0 || best <= 0)
+      break;
+    next = best_k;
+  }
+  return index;
+}
+
+}
@@ -0,0 +1,37 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <string>
+#include <vector>
+#include "CMesh.h"
+
+// Strategies to pick the initial samples from the original points. Every one
+// returns indices into vert; the spatial ones spread the samples more evenly
+// than a random subset, so fewer samples cover the shape equally well.
+namespace Sampler {
+
+enum METHOD { RANDOM = 0, ORDERED = 1, VOXEL = 2, POISSON = 3, FPS = 4 };
+
+// parse "random", "ordered", "voxel", "poisson" or "fps", -1 if unknown
+int methodFromName(const std::string &name);
+
+std::vector<int> select(int method, std::vector<CVertex> &vert, vcg::Box3f box, int want);
+
+// random subset, as GlobalFun::GetRandomCards
+std::vector<int> random(std::vector<CVertex> &vert, int want);
+
+// the point nearest to the center of every occupied voxel, the voxel size is
+// searched so that about want voxels are occupied
+std::vector<int> voxel(std::vector<CVertex> &vert, vcg::Box3f box, int want);
+
+// dart throwing in random order on a CGrid, no two samples are closer than a
+// radius tuned to give about want samples
+std::vector<int> poissonDisk(std::vector<CVertex> &vert, vcg::Box3f box, int want);
+
+// farthest point sampling over voxel representatives (a few per wanted
+// sample) instead of all points, which keeps it O(want^2)
+std::vector<int> farthestPoint(std::vector<CVertex> &vert, vcg::Box3f box, int want);
+
+}
+
+#endif
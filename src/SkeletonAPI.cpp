@@ -0,0 +1,220 @@
+#include "SkeletonAPI.h"
+
+#include <cmath>
+#include <unordered_map>
+
+namespace SkeletonAPI
+{
+
+// uniform grid over the skeleton nodes to find the nearest one of a point
+class NodeGrid
+{
+public:
+  NodeGrid(const std::vector<Point3f>& _nodes) : nodes(_nodes)
+  {
+    Box3f box;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      box.Add(nodes[i]);
+    }
+    origin = box.min;
+    cell_size = box.Diag() / std::max(1.0, std::cbrt((double)nodes.size()));
+    if (cell_size <= 0) {
+      cell_size = 1;
+    }
+    for (int i = 0; i < 3; i++) {
+      side[i] = (int)std::floor((box.max[i] - origin[i]) / cell_size) + 1;
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+      int c[3];
+      cellOf(nodes[i], c);
+      cells[key(c[0], c[1], c[2])].push_back(i);
+    }
+  }
+
+  int nearest(const Point3f& p) const
+  {
+    // a point outside the grid starts from the nearest cell of the grid; a
+    // node in ring k around that cell is still at least k - 1 cells from p
+    int c[3];
+    cellOf(p, c);
+    for (int i = 0; i < 3; i++) {
+      c[i] = std::min(std::max(c[i], 0), side[i] - 1);
+    }
+    int best = -1;
+    double best_dist2 = 0;
+    auto visit = [&](int x, int y, int z) {
+      auto it = cells.find(key(x, y, z));
+      if (it == cells.end()) {
+        return;
+      }
+      for (size_t j = 0; j < it->second.size(); j++) {
+        double dist2 = (p - nodes[it->second[j]]).SquaredNorm();
+        if (best < 0 || dist2 < best_dist2) {
+          best = it->second[j];
+          best_dist2 = dist2;
+        }
+      }
+    };
+
+    int rings = std::max(side[0], std::max(side[1], side[2]));
+    for (int k = 0; k < rings; k++) {
+      if (best >= 0 && best_dist2 <= (k - 1) * cell_size * (k - 1) * cell_size) {
+        break;
+      }
+      // the cells of ring k inside the grid: whole rows on the two z and y
+      // faces, only the two x ends in between
+      int lo[3], hi[3];
+      for (int i = 0; i < 3; i++) {
+        lo[i] = std::max(c[i] - k, 0);
+        hi[i] = std::min(c[i] + k, side[i] - 1);
+      }
+      for (int z = lo[2]; z <= hi[2]; z++) {
+        for (int y = lo[1]; y <= hi[1]; y++) {
+          if (std::abs(z - c[2]) == k || std::abs(y - c[1]) == k) {
+            for (int x = lo[0]; x <= hi[0]; x++) {
+              visit(x, y, z);
+            }
+            continue;
+          }
+          if (c[0] - k >= 0) {
+            visit(c[0] - k, y, z);
+          }
+          if (c[0] + k < side[0]) {
+            visit(c[0] + k, y, z);
+          }
+        }
+      }
+    }
+    return best;
+  }
+
+private:
+  void cellOf(const Point3f& p, int* c) const
+  {
+    for (int i = 0; i < 3; i++) {
+      c[i] = (int)std::floor((p[i] - origin[i]) / cell_size);
+    }
+  }
+
+  static long long key(int x, int y, int z)
+  {
+    return ((long long)(x & 0x1fffff) << 42) | ((long long)(y & 0x1fffff) << 21)
+           | (long long)(z & 0x1fffff);
+  }
+
+  const std::vector<Point3f>& nodes;
+  Point3f origin;
+  double cell_size;
+  int side[3];
+  std::unordered_map<long long, std::vector<int> > cells;
+};
+
+static void labelPoints(DataMgr* data, Result& result)
+{
+  CMesh* original = data->getCurrentOriginal();
+  Skeleton* skeleton = data->getCurrentSkeleton();
+  result.point_branch.assign(original->vert.size(), -1);
+  result.point_node.assign(original->vert.size(), -1);
+
+  std::vector<Point3f> nodes;
+  std::vector<int> node_branch, node_index;
+  for (size_t i = 0; i < skeleton->branches.size(); i++) {
+    Curve& curve = skeleton->branches[i].curve;
+    for (size_t j = 0; j < curve.size(); j++) {
+      nodes.push_back(curve[j].P());
+      node_branch.push_back(i);
+      node_index.push_back(j);
+    }
+  }
+  if (nodes.empty()) {
+    return;
+  }
+
+  NodeGrid grid(nodes);
+  long long n = original->vert.size();
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (long long i = 0; i < n; i++) {
+    int k = grid.nearest(original->vert[i].P());
+    if (k >= 0) {
+      result.point_branch[i] = node_branch[k];
+      result.point_node[i] = node_index[k];
+    }
+  }
+}
+
+bool skeletonize(SkeletonContext& context, const float* points, size_t count,
+                 size_t stride, const float* normals, size_t normal_stride,
+                 const Options& options, Result& result)
+{
+  result = Result();
+  context.setOriginal(points, count, stride, normals, normal_stride);
+  if (count == 0) {
+    context.clear();
+    return false;
+  }
+
+  const float* motion = options.motion.size() == 16 ? &options.motion[0] : NULL;
+  if (!options.sequence || !context.runNextFrame(motion, options.resume_stage)) {
+    context.sample(options.sampling_method, options.sample_num, options.radius);
+    context.run(options.pyramid_levels, options.pyramid_ratio);
+  }
+  result.sample_num = context.getData()->getCurrentSamples()->vn;
+
+  Skeleton* skeleton = context.getSkeleton();
+  result.branches.resize(skeleton->branches.size());
+  for (size_t i = 0; i < skeleton->branches.size(); i++) {
+    Curve& curve = skeleton->branches[i].curve;
+    std::vector<Node>& nodes = result.branches[i].nodes;
+    nodes.resize(curve.size());
+    for (size_t j = 0; j < curve.size(); j++) {
+      nodes[j].x = curve[j].P()[0];
+      nodes[j].y = curve[j].P()[1];
+      nodes[j].z = curve[j].P()[2];
+      nodes[j].radius = curve[j].skel_radius;
+      nodes[j].is_virtual = curve[j].is_skel_virtual;
+    }
+  }
+  result.stage_iterations = context.getAlgorithm()->getStageIterations();
+
+  if (options.label_points) {
+    labelPoints(context.getData(), result);
+  }
+
+  if (!options.sequence) {
+    context.clear();
+  }
+  return true;
+}
+
+bool skeletonize(SkeletonContext& context, const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                 const Options& options, Result& result)
+{
+  const float* points = cloud.points.empty() ? NULL : &cloud.points[0].x;
+  return skeletonize(context, points, cloud.points.size(), sizeof(pcl::PointXYZ),
+                     NULL, 0, options, result);
+}
+
+bool skeletonize(SkeletonContext& context, const pcl::PointCloud<pcl::PointNormal>& cloud,
+                 const Options& options, Result& result)
+{
+  const float* points = cloud.points.empty() ? NULL : &cloud.points[0].x;
+  const float* normals = cloud.points.empty() ? NULL : &cloud.points[0].normal_x;
+  return skeletonize(context, points, cloud.points.size(), sizeof(pcl::PointNormal),
+                     normals, sizeof(pcl::PointNormal), options, result);
+}
+
+bool skeletonize(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                 const Options& options, Result& result)
+{
+  SkeletonContext context;
+  return skeletonize(context, cloud, options, result);
+}
+
+bool skeletonize(const pcl::PointCloud<pcl::PointNormal>& cloud,
+                 const Options& options, Result& result)
+{
+  SkeletonContext context;
+  return skeletonize(context, cloud, options, result);
+}
+
+}
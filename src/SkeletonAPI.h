@@ -0,0 +1,75 @@
+#pragma once
+#include "SkeletonContext.h"
+#include "Sampler.h"
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <vector>
+
+// In-memory entry points of the library: points go in as a pcl cloud or a
+// strided float buffer, the skeleton comes back as plain structures. The
+// points are decoded once, straight into the original of the context.
+namespace SkeletonAPI
+{
+  struct Options
+  {
+    Options() : radius(0), sample_num(0), sampling_method(Sampler::RANDOM),
+                pyramid_levels(1), pyramid_ratio(4.0), label_points(false),
+                sequence(false), resume_stage(1) {}
+
+    double radius;          // initial radius, <= 0 derives it from the data
+    int sample_num;         // <= 0 uses every point as a sample
+    int sampling_method;    // Sampler::METHOD
+    int pyramid_levels;
+    double pyramid_ratio;
+    bool label_points;      // fill Result::point_branch / point_node
+    // frames of a sequence: the result stays in the context and the next
+    // frame starts from it, moved by motion (row-major 4x4 from the last
+    // frame to this one, empty if unknown) and resuming at resume_stage
+    bool sequence;
+    std::vector<float> motion;
+    int resume_stage;
+  };
+
+  struct Node
+  {
+    float x, y, z;
+    float radius;           // neighborhood radius the node was fixed at, -1 if unknown
+    bool is_virtual;
+  };
+
+  struct Branch
+  {
+    std::vector<Node> nodes;
+  };
+
+  struct Result
+  {
+    std::vector<Branch> branches;
+    // with Options::label_points, the nearest skeleton node of every input
+    // point as branch and node index, -1 when there is no skeleton
+    std::vector<int> point_branch;
+    std::vector<int> point_node;
+    // samples the skeletonization ran with and the iterations per stage
+    int sample_num;
+    std::vector<int> stage_iterations;
+  };
+
+  // the context keeps its buffers, so reuse it for a sequence of clouds;
+  // call it with Options::sequence for temporally coherent frames
+  bool skeletonize(SkeletonContext& context, const float* points, size_t count,
+                   size_t stride, const float* normals, size_t normal_stride,
+                   const Options& options, Result& result);
+
+  bool skeletonize(SkeletonContext& context, const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                   const Options& options, Result& result);
+  bool skeletonize(SkeletonContext& context, const pcl::PointCloud<pcl::PointNormal>& cloud,
+                   const Options& options, Result& result);
+
+  // one-shot versions on a fresh context built from global_paraMgr
+  bool skeletonize(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                   const Options& options, Result& result);
+  bool skeletonize(const pcl::PointCloud<pcl::PointNormal>& cloud,
+                   const Options& options, Result& result);
+}
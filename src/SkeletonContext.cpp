@@ -0,0 +1,105 @@
+#include "SkeletonContext.h"
+#include "Sampler.h"
+
+#include <cstdio>
+
+SkeletonContext::SkeletonContext(const ParameterMgr& base)
+  : paras(base),
+    data(paras.getDataParameterSet(), &paras),
+    algorithm(paras.getSkeletonParameterSet()),
+    sampling_method(Sampler::RANDOM)
+{
+}
+
+static void copyValues(RichParameterSet& dest, const RichParameterSet& source)
+{
+  for (int i = 0; i < source.paramList.size(); i++) {
+    RichParameter* p = source.paramList.at(i);
+    if (dest.hasParameter(p->name)) {
+      dest.setValue(p->name, *p->val);
+    }
+  }
+}
+
+void SkeletonContext::resetParameters(const ParameterMgr& base)
+{
+  copyValues(paras.glarea, base.glarea);
+  copyValues(paras.data, base.data);
+  copyValues(paras.drawer, base.drawer);
+  copyValues(paras.wLop, base.wLop);
+  copyValues(paras.norSmooth, base.norSmooth);
+  copyValues(paras.skeleton, base.skeleton);
+  copyValues(paras.upsampling, base.upsampling);
+}
+
+bool SkeletonContext::loadOriginal(const std::string& filename)
+{
+  return data.loadOriginal(filename);
+}
+
+void SkeletonContext::setOriginal(const float* points, size_t count, size_t stride,
+                                  const float* normals, size_t normal_stride)
+{
+  data.setOriginal(points, count, stride, normals, normal_stride);
+}
+
+void SkeletonContext::sample(int method, int want, double radius)
+{
+  int original_num = data.getCurrentOriginal()->vn;
+  if (want <= 0 || want >= original_num) {
+    want = original_num;
+    method = Sampler::ORDERED;
+  }
+  paras.data.setValue("Down Sample Num", DoubleValue(want));
+  data.downSamplesByMethod(method);
+  sampling_method = method;
+
+  // downSamplesByNum derives the radius from the data, keep the one asked for
+  if (radius <= 0) {
+    radius = data.init_radius;
+  }
+  DoubleValue r(radius);
+  paras.setGlobalParameter("CGrid Radius", r);
+  paras.setGlobalParameter("Initial Radius", r);
+}
+
+void SkeletonContext::run(int pyramid_levels, double pyramid_ratio)
+{
+  algorithm.setFirstIterate();
+  if (pyramid_levels > 1) {
+    algorithm.run_pyramid(&data, pyramid_levels, pyramid_ratio, sampling_method);
+  } else {
+    algorithm.run_full(&data);
+  }
+}
+
+bool SkeletonContext::runNextFrame(const float* motion, int resume_stage)
+{
+  if (!algorithm.warmStartFromPrevious(&data, motion, resume_stage)) {
+    return false;
+  }
+  algorithm.run_full(&data);
+  return true;
+}
+
+bool SkeletonContext::resume(const std::string& checkpoint)
+{
+  if (data.isOriginalEmpty() || !algorithm.loadCheckpoint(&data, checkpoint)) {
+    return false;
+  }
+  RichParameterSet* skeleton = paras.getSkeletonParameterSet();
+  DoubleValue radius(skeleton->getDouble("CGrid Radius"));
+  DoubleValue init_radius(skeleton->getDouble("Initial Radius"));
+  paras.setGlobalParameter("CGrid Radius", radius);
+  paras.setGlobalParameter("Initial Radius", init_radius);
+  algorithm.run_full(&data);
+  // the state it holds is consumed, a later resume must not start over from it
+  std::remove(checkpoint.c_str());
+  return true;
+}
+
+void SkeletonContext::clear()
+{
+  algorithm.clear();
+  data.clearData();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "ParameterMgr.h"
+#include "DataMgr.h"
+#include "Skeletonization.h"
+
+#include <string>
+
+// Everything one skeletonization works on: its own parameter sets (copied
+// from a ParameterMgr, global_paraMgr by default), the point data and the
+// algorithm with its scratch buffers. Independent contexts can run in
+// different threads at the same time (their ANN searches take turns, see
+// GlobalFun::computeAnnNeigbhors), and a context reused for many inputs
+// keeps its buffers from one to the next.
+class SkeletonContext
+{
+public:
+  explicit SkeletonContext(const ParameterMgr& base = global_paraMgr);
+
+  ParameterMgr* getParameterMgr() { return &paras; }
+  RichParameterSet* getDataParameterSet() { return paras.getDataParameterSet(); }
+  RichParameterSet* getSkeletonParameterSet() { return paras.getSkeletonParameterSet(); }
+
+  // set every parameter back to its value in base, the sets are kept
+  void resetParameters(const ParameterMgr& base);
+
+  bool loadOriginal(const std::string& filename);
+  // see DataMgr::setOriginal
+  void setOriginal(const float* points, size_t count, size_t stride,
+                   const float* normals = NULL, size_t normal_stride = 0);
+  // take want samples from the original with a Sampler::METHOD, want <= 0
+  // keeps all points in order; radius <= 0 keeps the radius derived from
+  // the data
+  void sample(int method, int want, double radius);
+  void run(int pyramid_levels = 1, double pyramid_ratio = 4.0);
+  // next frame of a sequence: after the original was replaced by the new
+  // frame, start from the samples and skeleton of the last run (see
+  // Skeletonization::warmStartFromPrevious) and run it. False, with nothing
+  // run, if there is no previous result; sample and run() the frame instead.
+  bool runNextFrame(const float* motion = NULL, int resume_stage = 1);
+  // continue an interrupted run from a checkpoint (see
+  // Skeletonization::setCheckpoint) of the original that is loaded, instead
+  // of sample and run(). False, with nothing run, if it does not fit. The
+  // checkpoint is removed once the run completes.
+  bool resume(const std::string& checkpoint);
+  // drop the points and the skeleton, the buffers stay allocated
+  void clear();
+
+  DataMgr* getData() { return &data; }
+  Skeleton* getSkeleton() { return data.getCurrentSkeleton(); }
+  Skeletonization* getAlgorithm() { return &algorithm; }
+
+private:
+  SkeletonContext(const SkeletonContext&);
+  SkeletonContext& operator=(const SkeletonContext&);
+
+  ParameterMgr paras;
+  DataMgr data;
+  Skeletonization algorithm;
+  int sampling_method;  // Sampler::METHOD of the last sample(), used again
+                        // by the coarse levels of a pyramid run
+};
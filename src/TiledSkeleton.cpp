@@ -0,0 +1,368 @@
+#include "TiledSkeleton.h"
+#include "PointIO.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <omp.h>
+using namespace std;
+using namespace vcg;
+
+namespace TiledSkeleton {
+
+// Coordinates of the input. Binary PCD and binary little-endian PLY data are
+// read in place from the mapping; other encodings are decoded once into a packed xyz array, which is
+// still far smaller than the CVertex of every point.
+class PointSource {
+  public:
+    PointSource() : body(NULL), step(0), count(0) {}
+
+    bool open(SkeletonContext &context, const std::string &filename, std::string &error) {
+      if(filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".pcd") == 0) {
+        if(!file.open(filename)) {
+          error = "could not map " + filename;
+          return false;
+        }
+        if(!header.parse(file.data(), file.size(), error))
+          return false;
+        const char *names[3] = { "x", "y", "z" };
+        for(int k = 0; k < 3; k++) {
+          int f = header.find(names[k]);
+          if(f < 0) {
+            error = string("no field ") + names[k];
+            return false;
+          }
+          fields[k] = header.fields[f];
+        }
+        count = header.points;
+
+        if(header.data_type == PointIO::PCDHeader::BINARY) {
+          if(file.size() - header.data_offset < count * header.point_step) {
+            error = "binary data is truncated";
+            return false;
+          }
+          body = file.data() + header.data_offset;
+          step = header.point_step;
+          return true;
+        }
+
+        xyz.resize(3 * count);
+        vector<string> sink_names(names, names + 3);
+        vector<PointIO::FloatSink> sinks;
+        for(int k = 0; k < 3; k++)
+          sinks.push_back(PointIO::FloatSink((char *)&xyz[k], 3 * sizeof(float)));
+        bool ok = PointIO::decodePCD(file, header, sink_names, sinks, error);
+        file.close();
+        return ok;
+      }
+
+      // vertex only binary_little_endian PLY is read in place as well, any
+      // other PLY encoding goes through the CMesh load below
+      if(filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".ply") == 0 &&
+         file.open(filename)) {
+        PointIO::PLYHeader ply;
+        string reason;
+        if(ply.parse(file.data(), file.size(), reason))
+          return openPLY(ply, error);
+        file.close();
+      }
+
+      if(!context.loadOriginal(filename)) {
+        error = "no points loaded";
+        return false;
+      }
+      CMesh *original = context.getData()->getCurrentOriginal();
+      count = original->vert.size();
+      xyz.resize(3 * count);
+      for(size_t i = 0; i < count; i++)
+        for(int k = 0; k < 3; k++)
+          xyz[3*i + k] = original->vert[i].P()[k];
+      context.clear();
+      return true;
+    }
+
+    size_t size() const { return count; }
+
+    Point3f point(size_t i) const {
+      if(body == NULL)
+        return Point3f(xyz[3*i], xyz[3*i + 1], xyz[3*i + 2]);
+      const char *p = body + i * step;
+      return Point3f(PointIO::readField(p + fields[0].offset, fields[0]),
+                     PointIO::readField(p + fields[1].offset, fields[1]),
+                     PointIO::readField(p + fields[2].offset, fields[2]));
+    }
+
+  private:
+    bool openPLY(const PointIO::PLYHeader &ply, std::string &error) {
+      const char *names[3] = { "x", "y", "z" };
+      for(int k = 0; k < 3; k++) {
+        int f = ply.find(names[k]);
+        if(f < 0) {
+          error = string("no property ") + names[k];
+          return false;
+        }
+        fields[k] = ply.properties[f];
+      }
+      count = ply.vertices;
+      if(file.size() - ply.data_offset < count * ply.vertex_step) {
+        error = "binary data is truncated";
+        return false;
+      }
+      body = file.data() + ply.data_offset;
+      step = ply.vertex_step;
+      return true;
+    }
+
+    PointIO::MappedFile file;
+    PointIO::PCDHeader header;
+    PointIO::PCDField fields[3];
+    const char *body;
+    size_t step;
+    size_t count;
+    vector<float> xyz;
+};
+
+// Regular grid of tiles over the bounding box.
+struct TileGrid {
+  Box3f box;
+  int side[3];
+  Point3f size;
+
+  int count() const { return side[0] * side[1] * side[2]; }
+
+  // the tile range [lo, hi] along axis i of everything within halo of v
+  void range(float v, double halo, int i, int &lo, int &hi) const {
+    lo = (int)floor((v - halo - box.min[i]) / size[i]);
+    hi = (int)floor((v + halo - box.min[i]) / size[i]);
+    lo = max(lo, 0);
+    hi = min(hi, side[i] - 1);
+  }
+
+  Box3f core(int t) const {
+    int c[3] = { t % side[0], (t / side[0]) % side[1], t / (side[0] * side[1]) };
+    Box3f b;
+    for(int i = 0; i < 3; i++) {
+      b.min[i] = box.min[i] + c[i] * size[i];
+      b.max[i] = (c[i] == side[i] - 1) ? box.max[i] : b.min[i] + size[i];
+    }
+    return b;
+  }
+};
+
+static Box3f boundingBox(const PointSource &source) {
+  long long n = source.size();
+  Box3f box;
+#pragma omp parallel
+  {
+    Box3f local;
+#pragma omp for schedule(static) nowait
+    for(long long i = 0; i < n; i++)
+      local.Add(source.point(i));
+#pragma omp critical
+    box.Add(local);
+  }
+  return box;
+}
+
+// Tiles of about equal extent; the tile edge shrinks until there are enough
+// tiles for the wanted points per tile, flat axes stay one tile thick.
+static TileGrid makeGrid(const Box3f &box, size_t points, size_t tile_points) {
+  TileGrid grid;
+  grid.box = box;
+  Point3f ext = box.max - box.min;
+  double want = ceil((double)points / max<size_t>(tile_points, 1));
+  double edge = max(ext[0], max(ext[1], ext[2]));
+  if(edge <= 0)
+    edge = 1;
+
+  for(int iter = 0; iter < 200; iter++) {
+    double n = 1;
+    for(int i = 0; i < 3; i++)
+      n *= max(1.0, ceil(ext[i] / edge));
+    if(n >= want)
+      break;
+    edge *= 0.9;
+  }
+  for(int i = 0; i < 3; i++) {
+    grid.side[i] = (int)max(1.0, ceil(ext[i] / edge));
+    grid.size[i] = ext[i] > 0 ? ext[i] / grid.side[i] : 1;
+  }
+  return grid;
+}
+
+// The radius a tile's run grows to, halo_ratio times its initial radius but
+// no more than "Max Stop Radius", where the runs stop. The initial radius is
+// the one given or the one DataMgr derives for a tile with its share of the
+// points. At most half a tile, so a point is in the halo of its neighbor
+// tiles only; zero with a single tile.
+static double defaultHalo(const TileGrid &grid, size_t points, const Options &options,
+                          RichParameterSet *data_para, RichParameterSet *skel_para) {
+  double extent = -1;
+  for(int i = 0; i < 3; i++)
+    if(grid.side[i] > 1 && (extent < 0 || grid.size[i] < extent))
+      extent = grid.size[i];
+  if(extent < 0)
+    return 0;
+
+  double radius = options.radius;
+  if(radius <= 0) {
+    Box3f tile;
+    tile.min = Point3f(0, 0, 0);
+    Point3f ext = grid.box.max - grid.box.min;
+    for(int i = 0; i < 3; i++)
+      tile.max[i] = tile.min[i] + (ext[i] > 0 ? grid.size[i] : 0);
+    radius = DataMgr::initRadius(tile, max(1.0, (double)points / grid.count()),
+                                 data_para->getDouble("Init Radius Para"));
+  }
+  double halo = min(options.halo_ratio * radius, skel_para->getDouble("Max Stop Radius"));
+  return min(halo, 0.5 * extent);
+}
+
+// Point indices of every tile including its halo, stored as one array with
+// an offset per tile. Every thread counts and then fills its own static block
+// of points, so the indices of a tile stay in file order.
+static void assignPoints(const PointSource &source, const TileGrid &grid, double halo,
+                         vector<size_t> &start, vector<unsigned int> &index) {
+  long long n = source.size();
+  int tiles = grid.count();
+  int threads = omp_get_max_threads();
+  vector<vector<size_t> > counts(threads, vector<size_t>(tiles + 1, 0));
+
+  // calls f(tile) for every tile whose halo box holds point i
+  auto visit = [&](long long i, vector<size_t> &where, bool fill) {
+    Point3f p = source.point(i);
+    int lo[3], hi[3];
+    for(int k = 0; k < 3; k++)
+      grid.range(p[k], halo, k, lo[k], hi[k]);
+    for(int z = lo[2]; z <= hi[2]; z++)
+      for(int y = lo[1]; y <= hi[1]; y++)
+        for(int x = lo[0]; x <= hi[0]; x++) {
+          int t = x + grid.side[0] * (y + grid.side[1] * z);
+          if(fill)
+            index[where[t]++] = i;
+          else
+            where[t]++;
+        }
+  };
+
+#pragma omp parallel num_threads(threads)
+  {
+    vector<size_t> &local = counts[omp_get_thread_num()];
+#pragma omp for schedule(static)
+    for(long long i = 0; i < n; i++)
+      visit(i, local, false);
+  }
+
+  // turn the counts into the first slot of every thread in every tile
+  start.assign(tiles + 1, 0);
+  size_t offset = 0;
+  for(int t = 0; t < tiles; t++) {
+    start[t] = offset;
+    for(int j = 0; j < threads; j++) {
+      size_t c = counts[j][t];
+      counts[j][t] = offset;
+      offset += c;
+    }
+  }
+  start[tiles] = offset;
+  index.resize(offset);
+
+#pragma omp parallel num_threads(threads)
+  {
+    vector<size_t> &local = counts[omp_get_thread_num()];
+#pragma omp for schedule(static)
+    for(long long i = 0; i < n; i++)
+      visit(i, local, true);
+  }
+}
+
+static inline bool inside(const Box3f &b, const Point3f &p) {
+  for(int i = 0; i < 3; i++)
+    if(p[i] < b.min[i] || p[i] > b.max[i])
+      return false;
+  return true;
+}
+
+// the runs of consecutive nodes inside the core box become branches
+static void clipBranches(Skeleton &tile, const Box3f &core, Skeleton &parts) {
+  for(int i = 0; i < tile.branches.size(); i++) {
+    Curve &curve = tile.branches[i].curve;
+    Branch part;
+    for(int j = 0; j <= curve.size(); j++) {
+      if(j < curve.size() && inside(core, curve[j].P())) {
+        part.pushBackCVertex(curve[j]);
+        continue;
+      }
+      if(part.getSize() >= 2)
+        parts.branches.push_back(part);
+      part = Branch();
+    }
+  }
+}
+
+bool run(SkeletonContext &context, const std::string &filename, const Options &options,
+         size_t &points, std::string &error) {
+  PointSource source;
+  if(!source.open(context, filename, error))
+    return false;
+  points = source.size();
+  if(points == 0) {
+    error = "no points loaded";
+    return false;
+  }
+
+  ParameterMgr base(*context.getParameterMgr());
+  RichParameterSet *para = context.getSkeletonParameterSet();
+  Box3f box = boundingBox(source);
+  TileGrid grid = makeGrid(box, points, options.tile_points);
+  double halo = options.halo > 0 ? options.halo :
+                defaultHalo(grid, points, options, context.getDataParameterSet(), para);
+  vector<size_t> start;
+  vector<unsigned int> index;
+  assignPoints(source, grid, halo, start, index);
+
+  LOG_INFO << "Tiled " << points << " points into " << grid.side[0] << "x" << grid.side[1]
+           << "x" << grid.side[2] << " tiles, halo " << halo;
+  if(halo >= min(grid.size[0], min(grid.size[1], grid.size[2])) && grid.count() > 1)
+    LOG_WARN << "The halo is larger than a tile, tiles overlap a lot";
+
+  Skeleton parts;
+  vector<float> xyz;
+  for(int t = 0; t < grid.count(); t++) {
+    size_t n = start[t+1] - start[t];
+    if(n < options.min_tile_points)
+      continue;
+
+    xyz.resize(3 * n);
+    const unsigned int *tile_index = &index[start[t]];
+#pragma omp parallel for schedule(static)
+    for(long long i = 0; i < (long long)n; i++) {
+      Point3f p = source.point(tile_index[i]);
+      xyz[3*i] = p[0];
+      xyz[3*i + 1] = p[1];
+      xyz[3*i + 2] = p[2];
+    }
+
+    Random::restart(t);
+    context.resetParameters(base);
+    context.setOriginal(&xyz[0], n, 3 * sizeof(float));
+    int want = options.sample_num > 0 ?
+               (int)max(1.0, (double)options.sample_num * n / points) : 0;
+    context.sample(options.sampling_method, want, options.radius);
+    context.run();
+
+    int before = parts.branches.size();
+    clipBranches(*context.getSkeleton(), grid.core(t), parts);
+    LOG_INFO << "Tile " << t + 1 << "/" << grid.count() << ": " << n << " points, "
+             << parts.branches.size() - before << " branches";
+    context.clear();
+  }
+
+  context.resetParameters(base);
+  context.getAlgorithm()->stitchSkeleton(parts, options.stitch_dist);
+  *context.getSkeleton() = parts;
+  return true;
+}
+
+}
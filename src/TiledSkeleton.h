@@ -0,0 +1,38 @@
+#ifndef TILED_SKELETON_H
+#define TILED_SKELETON_H
+
+#include <string>
+#include "SkeletonContext.h"
+
+// Skeletonization of clouds too large for one CMesh. The cloud is cut into a
+// grid of tiles, each grown by a halo, and the tiles are skeletonized one
+// after the other in the same context, so only one tile is ever held as
+// CVertex. The input stays memory mapped and only the coordinates of the
+// current tile are copied out of it. The branches of every tile are clipped to
+// the tile without its halo and the parts are stitched along the seams with
+// Skeletonization::stitchSkeleton.
+namespace TiledSkeleton {
+
+struct Options {
+  Options() : tile_points(2000000), halo(0), halo_ratio(4.0), radius(0), sample_num(0),
+              sampling_method(0), stitch_dist(0), min_tile_points(100) {}
+
+  size_t tile_points;   // target number of points in a tile without halo
+  double halo;          // <= 0 derives it, see defaultHalo
+  double halo_ratio;    // derived halo in initial radii of a tile
+  double radius;        // initial radius, <= 0 derives it for every tile
+  int sample_num;       // samples over the whole cloud, <= 0 uses every point
+  int sampling_method;  // Sampler::METHOD
+  double stitch_dist;   // <= 0 uses "Branches Merge Max Dist"
+  size_t min_tile_points;  // tiles with fewer points are skipped
+};
+
+// Skeletonize a PCD file (a PLY file is loaded whole and tiled in memory).
+// The stitched skeleton is left in the context, points says how many points
+// the file has. The parameters of the context are restored for every tile.
+bool run(SkeletonContext &context, const std::string &filename, const Options &options,
+         size_t &points, std::string &error);
+
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include "octree.h"
+
+#include <algorithm>
+using namespace std;
+using namespace vcg;
+
+// points below the split value along one axis go first
+class OctantSplit {
+  public:
+  OctantSplit(int _axis, float _value) : axis(_axis), value(_value) {}
+  bool operator()(const CVertex *a) const {
+    return a->P()[axis] < value;
+  }
+  int axis;
+  float value;
+};
+
+void COctree::init(std::vector<CVertex> &vert, int _leaf_size, int _max_depth) {
+  leaf_size = (_leaf_size > 0) ? _leaf_size : 1;
+  max_depth = (_max_depth < 60) ? _max_depth : 60;
+
+  samples.clear();
+  samples.reserve(vert.size());
+  for(int i = 0; i < vert.size(); i++)
+    samples.push_back(&vert[i]);
+
+  nodes.clear();
+  if(samples.empty())
+    return;
+
+  nodes.reserve(2 * samples.size() / leaf_size + 1);
+  build(0, samples.size(), 0);
+}
+
+int COctree::build(int start, int end, int depth) {
+  int id = nodes.size();
+  nodes.push_back(Node());
+
+  Box3f box;
+  Point3f center(0, 0, 0);
+  for(int i = start; i < end; i++) {
+    box.Add(samples[i]->P());
+    center += samples[i]->P();
+  }
+
+  Node &node = nodes[id];
+  node.box = box;
+  node.center = center / float(end - start);
+  node.count = end - start;
+  node.start = start;
+  node.end = end;
+  for(int c = 0; c < 8; c++)
+    node.child[c] = -1;
+
+  if(end - start <= leaf_size || depth >= max_depth || box.Diag() <= 0)
+    return id;
+
+  // split the range into the 8 octants around the box center,
+  // octant c holds bit 0 for x, bit 1 for y and bit 2 for z
+  Point3f mid = (box.min + box.max) / 2.0f;
+  int bounds[9];
+  bounds[0] = start;
+  bounds[8] = end;
+  std::vector<CVertex *>::iterator begin = samples.begin();
+  bounds[4] = partition(begin + start, begin + end, OctantSplit(2, mid[2])) - begin;
+  for(int z = 0; z < 2; z++) {
+    int zs = bounds[4*z], ze = bounds[4*z + 4];
+    bounds[4*z + 2] = partition(begin + zs, begin + ze, OctantSplit(1, mid[1])) - begin;
+    for(int y = 0; y < 2; y++) {
+      int ys = bounds[4*z + 2*y], ye = bounds[4*z + 2*y + 2];
+      bounds[4*z + 2*y + 1] = partition(begin + ys, begin + ye, OctantSplit(0, mid[0])) - begin;
+    }
+  }
+
+  for(int c = 0; c < 8; c++) {
+    if(bounds[c+1] > bounds[c]) {
+      // nodes may be reallocated while building the child
+      int child = build(bounds[c], bounds[c+1], depth + 1);
+      nodes[id].child[c] = child;
+    }
+  }
+  return id;
+}
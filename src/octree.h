@@ -0,0 +1,98 @@
+#ifndef SAMPLE_OCTREE_H
+#define SAMPLE_OCTREE_H
+
+#include <vector>
+#include "CMesh.h"
+using namespace std;
+
+// Octree over the sample points. Every node keeps the number of points below
+// it and their center of mass, so a far away cluster can stand in for all of
+// its points as a single pseudo-particle (Barnes-Hut).
+class COctree {
+  public:
+    struct Node {
+      vcg::Box3f box;         // tight box of the points in this node
+      vcg::Point3f center;    // center of mass
+      int count;
+      int start, end;         // range in samples
+      int child[8];           // -1 if the octant is empty, all -1 for leaves
+      bool isLeaf() const { return child[0] < 0 && child[1] < 0 && child[2] < 0 && child[3] < 0 &&
+                                   child[4] < 0 && child[5] < 0 && child[6] < 0 && child[7] < 0; }
+    };
+
+    std::vector<CVertex *> samples;
+    std::vector<Node> nodes;
+
+    COctree() {}
+    // every point is in the tree, ignored samples (is_skel_ignore) included,
+    // the same set the exact neighbor search sees; callers skip them as
+    // query sources
+    void init(std::vector<CVertex> &vert, int leaf_size = 8, int max_depth = 16);
+
+    // Visit everything within radius of p. Points of opened nodes are handed
+    // to near(CVertex&) one by one; a node that lies completely inside the
+    // ball and looks small from p (box diagonal / distance < theta) is handed
+    // to far(center, count) as a whole. theta <= 0 always opens the nodes.
+    template <class Near, class Far>
+    void query(const vcg::Point3f &p, double radius, double theta, Near &near, Far &far);
+
+  private:
+    int build(int start, int end, int depth);
+
+    int leaf_size, max_depth;
+};
+
+
+template <class Near, class Far>
+void COctree::query(const vcg::Point3f &p, double radius, double theta, Near &near, Far &far) {
+  if(nodes.empty())
+    return;
+
+  double radius2 = radius*radius;
+  double theta2 = theta*theta;
+
+  int stack[8*64];
+  int top = 0;
+  stack[top++] = 0;
+  while(top > 0) {
+    Node &node = nodes[stack[--top]];
+
+    // closest and farthest distance from p to the node box
+    double min2 = 0, max2 = 0;
+    for(int i = 0; i < 3; i++) {
+      double lo = node.box.min[i] - p[i];
+      double hi = p[i] - node.box.max[i];
+      double d = lo > 0 ? lo : (hi > 0 ? hi : 0);
+      min2 += d*d;
+      double f = lo < 0 ? -lo : lo;
+      double g = hi < 0 ? -hi : hi;
+      f = f > g ? f : g;
+      max2 += f*f;
+    }
+    if(min2 >= radius2)
+      continue;
+
+    if(theta > 0 && max2 < radius2 && min2 > 0) {
+      double size2 = (node.box.max - node.box.min).SquaredNorm();
+      double dist2 = (p - node.center).SquaredNorm();
+      if(size2 < theta2 * dist2) {
+        far(node.center, node.count);
+        continue;
+      }
+    }
+
+    if(node.isLeaf()) {
+      for(int i = node.start; i < node.end; i++) {
+        if((p - samples[i]->P()).SquaredNorm() < radius2)
+          near(*samples[i]);
+      }
+      continue;
+    }
+
+    for(int c = 0; c < 8; c++)
+      if(node.child[c] >= 0)
+        stack[top++] = node.child[c];
+  }
+}
+
+#endif
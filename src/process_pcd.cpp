@@ -1,19 +1,343 @@
 #include "CMesh.h"
 #include "DataMgr.h"
 #include "Skeletonization.h"
+#include "SkeletonContext.h"
+#include "Sampler.h"
+#include "TiledSkeleton.h"
+#include "ComponentSkeleton.h"
+
+#include "PointIO.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "Log.h"
 
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <glob.h>
+#include <omp.h>
+
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
 
+struct BatchOptions
+{
+  double radius;
+  double component_radius;  // <= 0 derives it for every component
+  int down_sample_num;
+  int sampling_method;
+  int pyramid_levels;
+  double pyramid_ratio;
+  bool sequence;
+  int resume_stage;
+  size_t tile_points;
+  double tile_halo;
+  double component_gap;
+  int component_min_points;
+  int component_jobs;
+  bool skel_binary;
+  bool save_samples;
+  int checkpoint_every;
+  bool resume;
+  int metrics_format;  // IterationMetricsWriter::FORMAT, -1 writes none
+};
+
+struct BatchResult
+{
+  BatchResult() : ok(false), points(0), branches(0), seconds(0) {}
+  bool ok;
+  int points;
+  int branches;
+  double seconds;
+  std::string message;
+};
+
+// Blocks a worker until its estimated memory fits into the budget. A file
+// larger than the whole budget still runs, but only when nothing else does.
+class MemoryBudget
+{
+public:
+  MemoryBudget(size_t _limit) : limit(_limit), used(0) {}
+
+  void acquire(size_t bytes) {
+    if (limit == 0) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]() { return used == 0 || used + bytes <= limit; });
+    used += bytes;
+  }
+
+  void release(size_t bytes) {
+    if (limit == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    used -= bytes;
+    cond.notify_all();
+  }
+
+private:
+  size_t limit;
+  size_t used;
+  std::mutex mutex;
+  std::condition_variable cond;
+};
+
+// add a file, or every match of a glob pattern, to the inputs
+static void
+expandInput(const std::string& pattern, std::vector<std::string>& inputs)
+{
+  if (pattern.find_first_of("*?[") == std::string::npos) {
+    inputs.push_back(pattern);
+    return;
+  }
+
+  glob_t matches;
+  if (glob(pattern.c_str(), 0, NULL, &matches) == 0) {
+    for (size_t i = 0; i < matches.gl_pathc; i++) {
+      inputs.push_back(matches.gl_pathv[i]);
+    }
+  } else {
+    LOG_WARN << "No file matches " << pattern;
+  }
+  globfree(&matches);
+}
+
+// every output is named after the input without its extension (<stem>.skel.pcd,
+// <stem>.ckpt, ...), so two inputs with the same stem, such as scan.pcd and
+// scan.ply next to each other, would overwrite each other's results
+static bool
+checkOutputNames(const std::vector<std::string>& inputs)
+{
+  std::map<std::string, std::string> stems;
+  bool ok = true;
+  for (const std::string& input : inputs) {
+    fs::path stem = fs::absolute(input).lexically_normal().replace_extension();
+    auto found = stems.insert(std::make_pair(stem.string(), input));
+    if (!found.second) {
+      std::cerr << input << " and " << found.first->second << " would both write "
+                << stem.string() << ".skel.pcd" << std::endl;
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// rough peak memory of one file: original and samples as CVertex plus the
+// grids and per-point buffers of the iteration
+static size_t
+estimateMemory(const std::string& input)
+{
+  size_t points = 0;
+  PointIO::MappedFile file;
+  PointIO::PCDHeader header;
+  std::string error;
+  if (file.open(input)) {
+    if (input.size() > 4 && input.compare(input.size() - 4, 4, ".pcd") == 0 &&
+        header.parse(file.data(), file.size(), error)) {
+      points = header.points;
+    } else {
+      points = file.size() / (3 * sizeof(float));
+    }
+  }
+  return points * (2 * sizeof(CVertex) + 64);
+}
+
+// read one row-major 4x4 matrix per line, the motion from the frame before
+static bool
+readMotions(const std::string& filename, std::vector<std::vector<float> >& motions)
+{
+  std::ifstream in(filename.c_str());
+  if (!in.is_open()) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream values(line);
+    std::vector<float> m;
+    float v;
+    while (values >> v) {
+      m.push_back(v);
+    }
+    if (m.size() != 16) {
+      return false;
+    }
+    motions.push_back(m);
+  }
+  return true;
+}
+
+// skeletonize one input in the worker's context and save the result; in a
+// sequence the frame starts from the previous one still held by the context
+static bool
+processFile(const std::string& input, const BatchOptions& options,
+            const float* motion, SkeletonContext& context, BatchResult& result)
+{
+  Profiler::Scope profile("processFile");
+  fs::path outp(input);
+  outp.replace_extension(".skel.pcd");
+
+  // checkpoints (<stem>.ckpt) only cover runs over the whole input
+  std::string checkpoint = fs::path(input).replace_extension(".ckpt").string();
+  bool whole = options.tile_points == 0 && options.component_gap <= 0;
+  context.getAlgorithm()->setCheckpoint(checkpoint, whole ? options.checkpoint_every : 0);
+
+  // so are the iteration metrics (<stem>.metrics.csv or .jsonl)
+  IterationMetricsWriter metrics;
+  if (whole && options.metrics_format >= 0) {
+    std::string metrics_file = fs::path(input).replace_extension(
+        options.metrics_format == IterationMetricsWriter::CSV ? ".metrics.csv" : ".metrics.jsonl")
+        .string();
+    std::string error;
+    if (metrics.open(metrics_file, options.metrics_format, error)) {
+      context.getAlgorithm()->setMetricsCallback(
+          [&metrics](const IterationMetrics& m) { metrics.write(m); });
+    } else {
+      LOG_WARN << error;
+    }
+  }
+  struct MetricsReset {
+    Skeletonization* algorithm;
+    ~MetricsReset() { algorithm->setMetricsCallback(IterationMetricsCallback()); }
+  } metrics_reset = { context.getAlgorithm() };
+
+  // large inputs are streamed tile by tile from the mapped file
+  if (options.tile_points > 0) {
+    TiledSkeleton::Options tiled;
+    tiled.tile_points = options.tile_points;
+    tiled.halo = options.tile_halo;
+    tiled.radius = options.radius;
+    tiled.sample_num = options.down_sample_num;
+    tiled.sampling_method = options.sampling_method;
+    size_t points = 0;
+    if (!TiledSkeleton::run(context, input, tiled, points, result.message)) {
+      return false;
+    }
+    result.points = points;
+    result.branches = context.getSkeleton()->branches.size();
+    context.getSkeleton()->saveToPCD(outp.string());
+    if (options.skel_binary) {
+      context.getData()->saveSkeletonAsBinary(fs::path(input).replace_extension(".skelb").string());
+    }
+    return true;
+  }
+
+  // load the input once, the samples are taken from it in memory
+  if (!context.loadOriginal(input)) {
+    result.message = "no points loaded";
+    return false;
+  }
+  result.points = context.getData()->getCurrentOriginal()->vn;
+
+  // run the skeletonization algorithm
+  if (options.component_gap > 0) {
+    ComponentSkeleton::Options components;
+    components.gap = options.component_gap;
+    components.min_points = options.component_min_points;
+    components.sample_num = options.down_sample_num;
+    components.sampling_method = options.sampling_method;
+    components.radius = options.component_radius;
+    components.pyramid_levels = options.pyramid_levels;
+    components.pyramid_ratio = options.pyramid_ratio;
+    components.jobs = options.component_jobs;
+    ComponentSkeleton::run(context, components);
+  } else {
+    bool resumed = options.resume && fs::exists(checkpoint) && context.resume(checkpoint);
+    if (!resumed && (!options.sequence || !context.runNextFrame(motion, options.resume_stage))) {
+      context.sample(options.sampling_method, options.down_sample_num, options.radius);
+      context.run(options.pyramid_levels, options.pyramid_ratio);
+    }
+  }
+
+  // extract the skeleton
+  Skeleton* skel = context.getSkeleton();
+  result.branches = skel->branches.size();
+
+  // save the skeleton as a PCD file
+  skel->saveToPCD(outp.string());
+  if (options.save_samples) {
+    context.getData()->savePCD(fs::path(input).replace_extension(".samples.pcd").string(),
+                               *context.getData()->getCurrentSamples());
+  }
+  if (options.skel_binary) {
+    context.getData()->saveSkeletonAsBinary(fs::path(input).replace_extension(".skelb").string());
+  }
+  return true;
+}
+
+// convert a .skel file to the binary format or back, by the extension
+static int
+convertSkel(const std::string& input)
+{
+  DataMgr data(global_paraMgr.getDataParameterSet());
+  fs::path outp(input);
+  bool ok;
+  if (outp.extension() == ".skelb") {
+    ok = data.loadSkeletonFromBinary(input);
+    if (ok) {
+      outp.replace_extension(".skel");
+      data.saveSkeletonAsSkel(QString(outp.string().c_str()));
+    }
+  } else {
+    data.loadSkeletonFromSkel(QString(input.c_str()));
+    outp.replace_extension(".skelb");
+    ok = data.saveSkeletonAsBinary(outp.string());
+  }
+  if (!ok) {
+    std::cerr << "Could not convert " << input << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << outp.string() << std::endl;
+  return 0;
+}
+
 int
 main(int argc, char** argv)
 {
   double radius;
   double mu_repulsion;
+  double repulsion_theta;
   double h_gaussian;
+  double stop_percentile;
+  double freeze_epsilon;
+  int freeze_iterations;
+  std::string acceleration;
+  double momentum;
+  int anderson_depth;
+  int pyramid_levels;
+  double pyramid_ratio;
+  int down_sample_num;
+  std::string sampling;
+  std::string list_file;
+  int jobs;
+  double memory_budget_mb;
+  std::string motion_file;
+  int resume_stage;
+  double tile_points;
+  double tile_halo;
+  double component_gap;
+  int component_min_points;
+  int component_jobs;
+  int checkpoint_every;
+  unsigned long long seed;
+  std::string log_level;
+  std::string metrics_format;
+  std::string profile_file;
+  std::string profile_format;
+  std::string convert_skel;
   
   // parse the CLI arguments
   po::variables_map vm;
@@ -22,18 +346,137 @@ main(int argc, char** argv)
     ("help,h", "Ask for help")
     ("initial-radius,r",
      po::value<double>(&radius)->default_value(0.05),
-     "Initial radius for local point neighborhoods")
+     "Initial radius for local point neighborhoods "
+     "(<= 0 to derive it from the bounding box and the point count)")
     ("mu-repulsion,m",
      po::value<double>(&mu_repulsion)->default_value(0.35),
      "Repulsion value for conditional regularization")
+    ("repulsion-theta",
+     po::value<double>(&repulsion_theta)->default_value(0.0),
+     "Barnes-Hut opening angle for the repulsion term (0 = exact)")
     ("h-gaussian,g",
      po::value<double>(&h_gaussian)->default_value(4),
      "H-Gaussian value")
-    ("input-file", "Input PCD files")
+    ("stop-percentile",
+     po::value<double>(&stop_percentile)->default_value(0),
+     "Stop a radius stage when this percentile of the sample movements is "
+     "below the stop error (0 = use the mean movement)")
+    ("freeze-epsilon",
+     po::value<double>(&freeze_epsilon)->default_value(0),
+     "Freeze samples that move less than this (0 = never freeze)")
+    ("freeze-iterations",
+     po::value<int>(&freeze_iterations)->default_value(3),
+     "Number of still iterations before a sample is frozen")
+    ("acceleration",
+     po::value<std::string>(&acceleration)->default_value("plain"),
+     "WLOP fixed point acceleration: plain, momentum or anderson")
+    ("momentum",
+     po::value<double>(&momentum)->default_value(0.3),
+     "Momentum factor for --acceleration momentum")
+    ("anderson-depth",
+     po::value<int>(&anderson_depth)->default_value(5),
+     "History depth for --acceleration anderson")
+    ("persist-density",
+     "Keep the original density next to the input file (<input>.density) "
+     "and reuse it on later runs")
+    ("pyramid-levels",
+     po::value<int>(&pyramid_levels)->default_value(1),
+     "Number of coarse-to-fine levels (1 = single resolution)")
+    ("pyramid-ratio",
+     po::value<double>(&pyramid_ratio)->default_value(4.0),
+     "Point count ratio between two pyramid levels")
+    ("down-sample-num,n",
+     po::value<int>(&down_sample_num)->default_value(0),
+     "Number of samples taken from the input points (0 = all of them)")
+    ("sampling",
+     po::value<std::string>(&sampling)->default_value("random"),
+     "How samples are chosen with --down-sample-num: random, ordered, "
+     "voxel, poisson or fps")
+    ("list",
+     po::value<std::string>(&list_file),
+     "File with one input (or glob pattern) per line")
+    ("jobs,j",
+     po::value<int>(&jobs)->default_value(1),
+     "Number of files processed at the same time")
+    ("memory-budget",
+     po::value<double>(&memory_budget_mb)->default_value(0),
+     "Estimated memory in MB the concurrent files may use (0 = no limit)")
+    ("sequence",
+     "The inputs are frames of one sequence, in order: every frame starts "
+     "from the skeleton of the one before (implies --jobs 1)")
+    ("motions",
+     po::value<std::string>(&motion_file),
+     "With --sequence, a file with the rigid motion from the previous frame "
+     "for every frame after the first, one row-major 4x4 matrix per line")
+    ("resume-stage",
+     po::value<int>(&resume_stage)->default_value(1),
+     "With --sequence, the radius stage of the previous frame a frame "
+     "resumes at")
+    ("tile-points",
+     po::value<double>(&tile_points)->default_value(0),
+     "Skeletonize large inputs in tiles of about this many points, stitched "
+     "afterwards (0 = the whole input at once)")
+    ("tile-halo",
+     po::value<double>(&tile_halo)->default_value(0),
+     "Overlap added around every tile (0 = four initial radii of a tile, "
+     "at most the maximum stop radius and half a tile)")
+    ("component-gap",
+     po::value<double>(&component_gap)->default_value(0),
+     "Split the input into the parts no closer than this to each other and "
+     "skeletonize each on its own, with the --initial-radius given or else "
+     "a radius derived for the part (0 = off)")
+    ("component-min-points",
+     po::value<int>(&component_min_points)->default_value(50),
+     "Parts with fewer points are dropped with --component-gap")
+    ("component-jobs",
+     po::value<int>(&component_jobs)->default_value(1),
+     "Parts skeletonized at the same time with --component-gap "
+     "(0 = one per thread)")
+    ("skel-binary",
+     "Also save the samples and the skeleton in the binary skeleton format "
+     "(<stem>.skelb)")
+    ("save-samples",
+     "Also save the samples the skeletonization ended with, with their "
+     "normals, confidence and flags (<stem>.samples.pcd)")
+    ("checkpoint-every",
+     po::value<int>(&checkpoint_every)->default_value(0),
+     "Write the complete state to <stem>.ckpt every this many iterations, "
+     "removed when the run completes (0 = off)")
+    ("resume",
+     "Continue every input that has a checkpoint from it, with the same "
+     "result as an uninterrupted run")
+    ("seed",
+     po::value<unsigned long long>(&seed),
+     "Seed of every random choice, for reproducible runs; every input gets "
+     "its own stream, so the result does not depend on --jobs (default: "
+     "from the clock)")
+    ("metrics",
+     po::value<std::string>(&metrics_format),
+     "Write what every iteration did (radius, error, sample, neighbor and "
+     "branch counts, timings) to <stem>.metrics.csv or .metrics.jsonl, "
+     "by this format: csv or jsonl")
+    ("log-level",
+     po::value<std::string>(&log_level)->default_value("info"),
+     "Messages shown: error, warn, info (progress and results), debug (every "
+     "stage and neighbor search) or trace")
+    ("profile",
+     po::value<std::string>(&profile_file),
+     "Time every stage of the run and write the timings to this file")
+    ("profile-format",
+     po::value<std::string>(&profile_format)->default_value("summary"),
+     "Format of --profile: summary (JSON totals, counts and percentiles of "
+     "every stage) or chrome (every call as a Chrome trace)")
+    ("convert-skel",
+     po::value<std::string>(&convert_skel),
+     "Convert a .skel file to .skelb or a .skelb file to .skel and exit")
+    ("input-file", po::value<std::vector<std::string> >(),
+     "Input PCD, PLY or XYZ(N)/TXT files or glob patterns; the skeleton is "
+     "written to <stem>.skel.pcd, the input without its extension, so no two "
+     "inputs may share a stem")
     ; 
 
   po::positional_options_description pos;
-  pos.add("input-file", 1);
+  pos.add("input-file", -1);
 
   po::store(po::command_line_parser(argc,argv)
             .options(opts).positional(pos).run(), vm);
@@ -44,11 +487,57 @@ main(int argc, char** argv)
     exit(0);
   }
 
-  if (vm.count("input-file") < 1) {
-    std::cerr << "Need at least one PCD file" << std::endl;
+  if (vm.count("convert-skel")) {
+    return convertSkel(convert_skel);
+  }
+
+  int sampling_method = Sampler::methodFromName(sampling);
+  if (sampling_method < 0) {
+    std::cerr << "Unknown sampling: " << sampling << std::endl;
     exit(1);
   }
-  
+
+  // the parts of a frame are not matched to those of the frame before
+  if (component_gap > 0 && vm.count("sequence")) {
+    std::cerr << "--sequence can not be used with --component-gap" << std::endl;
+    exit(1);
+  }
+
+  int level = Log::levelFromName(log_level);
+  if (level < 0) {
+    std::cerr << "Unknown log level: " << log_level << std::endl;
+    exit(1);
+  }
+  Log::setLevel(level);
+
+  int metrics_format_id = -1;
+  if (vm.count("metrics")) {
+    metrics_format_id = IterationMetricsWriter::formatFromName(metrics_format);
+    if (metrics_format_id < 0) {
+      std::cerr << "Unknown metrics format: " << metrics_format << std::endl;
+      exit(1);
+    }
+  }
+
+  if (profile_format != "summary" && profile_format != "chrome") {
+    std::cerr << "Unknown profile format: " << profile_format << std::endl;
+    exit(1);
+  }
+  Profiler::setEnabled(vm.count("profile") > 0);
+  if (vm.count("seed")) {
+    Random::setSeed(seed);
+  }
+
+  int acceleration_mode = 0;
+  if (acceleration == "momentum") {
+    acceleration_mode = 1;
+  } else if (acceleration == "anderson") {
+    acceleration_mode = 2;
+  } else if (acceleration != "plain") {
+    std::cerr << "Unknown acceleration: " << acceleration << std::endl;
+    exit(1);
+  }
+
   // prepare the parameter set
   RichParameterSet* datapara = global_paraMgr.getDataParameterSet();
   RichParameterSet* skelpara = global_paraMgr.getSkeletonParameterSet();
@@ -56,36 +545,181 @@ main(int argc, char** argv)
   auto mu = DoubleValue(mu_repulsion);
   datapara->setValue("CGrid Radius", grid_radius);
   skelpara->setValue("Repulsion Mu", mu);
+  skelpara->setValue("Repulsion Opening Angle", DoubleValue(repulsion_theta));
   skelpara->setValue("CGrid Radius", grid_radius);
   skelpara->setValue("Initial Radius", grid_radius);
   skelpara->setValue("H Gaussian Para", DoubleValue(h_gaussian));
   skelpara->setValue("Run Auto Wlop One Step", BoolValue(true));
+  skelpara->setValue("Stop Error Percentile", DoubleValue(stop_percentile));
+  skelpara->setValue("Freeze Move Epsilon", DoubleValue(freeze_epsilon));
+  skelpara->setValue("Freeze Still Iterations", DoubleValue(freeze_iterations));
+  skelpara->setValue("Acceleration Mode", IntValue(acceleration_mode));
+  skelpara->setValue("Acceleration Momentum", DoubleValue(momentum));
+  skelpara->setValue("Anderson Depth", DoubleValue(anderson_depth));
+  skelpara->setValue("Persist Original Density",
+                     BoolValue(vm.count("persist-density") > 0));
 
-  // load the specified PCD file
-  std::string input = vm["input-file"].as<std::string>();
-  DataMgr input_data(datapara);
-  if (input.find(".pcd") != std::string::npos) {
-    input_data.loadPCD(input, false);
-  } else {
-    input_data.loadPlyToOriginal(input.c_str());
+  // collect the inputs
+  std::vector<std::string> inputs;
+  if (vm.count("input-file")) {
+    for (const std::string& arg : vm["input-file"].as<std::vector<std::string> >()) {
+      expandInput(arg, inputs);
+    }
+  }
+  if (vm.count("list")) {
+    std::ifstream list(list_file.c_str());
+    if (!list.is_open()) {
+      std::cerr << "Could not open the list file " << list_file << std::endl;
+      exit(1);
+    }
+    std::string line;
+    while (std::getline(list, line)) {
+      line.erase(0, line.find_first_not_of(" \t\r"));
+      line.erase(line.find_last_not_of(" \t\r") + 1);
+      if (!line.empty() && line[0] != '#') {
+        expandInput(line, inputs);
+      }
+    }
+  }
+  if (inputs.empty()) {
+    std::cerr << "Need at least one point file" << std::endl;
+    exit(1);
+  }
+  if (!checkOutputNames(inputs)) {
+    exit(1);
   }
-  input_data.loadPCD(input, true); // samples are original
-  //input_data.downSamplesByNum(true);
-  
-  Skeletonization skel_algo(skelpara);
 
-  // run the skeletonization algorithm
-  skel_algo.run_full(&input_data);
+  BatchOptions options;
+  options.radius = radius;
+  options.down_sample_num = down_sample_num;
+  options.sampling_method = sampling_method;
+  options.pyramid_levels = pyramid_levels;
+  options.pyramid_ratio = pyramid_ratio;
+  options.sequence = vm.count("sequence") > 0;
+  options.resume_stage = resume_stage;
+  options.tile_points = tile_points > 0 ? (size_t)tile_points : 0;
+  options.tile_halo = tile_halo;
+  options.component_gap = component_gap;
+  options.component_min_points = component_min_points;
+  options.component_jobs = component_jobs;
+  options.component_radius = vm["initial-radius"].defaulted() ? 0 : radius;
+  options.skel_binary = vm.count("skel-binary") > 0;
+  options.save_samples = vm.count("save-samples") > 0;
+  options.checkpoint_every = checkpoint_every;
+  options.resume = vm.count("resume") > 0;
+  options.metrics_format = metrics_format_id;
 
-  // extract the skeleton
-  Skeleton* skel = input_data.getCurrentSkeleton();
+  std::vector<std::vector<float> > motions;
+  if (vm.count("motions") && !readMotions(motion_file, motions)) {
+    std::cerr << "Could not read the motions from " << motion_file << std::endl;
+    exit(1);
+  }
 
-  // save the skeleton as a PCD file
-  fs::path outp(input);
-  outp.replace_extension(".skel.pcd");
-  skel->saveToPCD(outp.string());
+  // with several workers every one gets a share of the OpenMP threads
+  if (options.sequence) {
+    jobs = 1;
+  }
+  if (jobs < 1) {
+    jobs = 1;
+  }
+  if (jobs > inputs.size()) {
+    jobs = inputs.size();
+  }
+  int threads_per_job = std::max(1, omp_get_max_threads() / jobs);
 
-  // optionally visualize
-  
-  return 0;
+  // the parameters every file starts from
+  ParameterMgr base_paras(global_paraMgr);
+
+  MemoryBudget budget((size_t)(memory_budget_mb * 1024.0 * 1024.0));
+  std::vector<BatchResult> results(inputs.size());
+  std::atomic<size_t> next(0);
+
+  auto worker = [&]() {
+    if (jobs > 1) {
+      omp_set_num_threads(threads_per_job);
+    }
+
+    // every worker keeps its context, so the point buffers are reused from
+    // one file to the next
+    SkeletonContext context(base_paras);
+
+    for (size_t i = next++; i < inputs.size(); i = next++) {
+      size_t need = estimateMemory(inputs[i]);
+      budget.acquire(need);
+      auto start = std::chrono::steady_clock::now();
+      BatchResult& result = results[i];
+      // a sequence frame keeps the radii of the frame before
+      bool warm = options.sequence && !context.getData()->isSamplesEmpty();
+      const float* motion = (warm && i > 0 && i - 1 < motions.size()) ?
+                            &motions[i - 1][0] : NULL;
+      try {
+        // the random numbers of a file depend only on its name and the seed
+        Random::restart(Random::key(inputs[i]));
+        // the parameters change while running, start from the base values
+        if (!warm) {
+          context.resetParameters(base_paras);
+        }
+        result.ok = processFile(inputs[i], options, motion, context, result);
+      } catch (const std::exception& e) {
+        result.ok = false;
+        result.message = e.what();
+      }
+      if (!options.sequence || !result.ok) {
+        context.clear();
+      }
+      budget.release(need);
+      result.seconds = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count();
+
+      if (result.ok) {
+        LOG_INFO << "[" << i + 1 << "/" << inputs.size() << "] " << inputs[i]
+                 << ": " << result.points << " points, " << result.branches
+                 << " branches, " << result.seconds << " s";
+      } else {
+        LOG_ERROR << "[" << i + 1 << "/" << inputs.size() << "] " << inputs[i]
+                  << " FAILED after " << result.seconds << " s: "
+                  << result.message;
+      }
+    }
+  };
+
+  auto batch_start = std::chrono::steady_clock::now();
+  if (jobs == 1) {
+    worker();
+  } else {
+    std::vector<std::thread> pool;
+    for (int j = 0; j < jobs; j++) {
+      pool.emplace_back(worker);
+    }
+    for (std::thread& t : pool) {
+      t.join();
+    }
+  }
+  double batch_seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - batch_start).count();
+
+  int failed = 0;
+  for (const BatchResult& result : results) {
+    if (!result.ok) {
+      failed++;
+    }
+  }
+  if (inputs.size() > 1) {
+    LOG_INFO << "Processed " << inputs.size() << " files in " << batch_seconds
+             << " s with " << jobs << " workers, " << failed << " failed";
+  }
+
+  if (Profiler::isEnabled()) {
+    Log::flush();
+    Profiler::print(std::cout);
+    std::string error;
+    bool written = profile_format == "chrome" ?
+                   Profiler::writeChromeTrace(profile_file, error) :
+                   Profiler::writeJSON(profile_file, error);
+    if (!written) {
+      LOG_ERROR << error;
+    }
+  }
+
+  return failed > 0 ? 1 : 0;
 }
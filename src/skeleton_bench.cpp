@@ -0,0 +1,418 @@
+#include "CMesh.h"
+#include "DataMgr.h"
+#include "GlobalFunction.h"
+#include "Skeletonization.h"
+#include "SkeletonContext.h"
+#include "Sampler.h"
+#include "grid.h"
+
+#include "Profiler.h"
+#include "Random.h"
+#include "Log.h"
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <glob.h>
+#include <omp.h>
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+#ifndef SKELETON_MODELS_DIR
+#define SKELETON_MODELS_DIR "models"
+#endif
+
+// Benchmark of the whole pipeline and of its kernels over a fixed set of
+// models. Every model is loaded, sampled with the deterministic voxel sampler
+// and skeletonized with the same parameters and random numbers on every
+// run; the kernels that are not public (the WLOP iteration, branch search and
+// merge) are timed by their Profiler sections inside the pipeline. Every
+// measurement is one JSON line, so results of different versions can be
+// compared by model and kernel. With --compare-acceleration the pipeline
+// also runs with every WLOP acceleration mode, whose iterations can be
+// compared with those of the plain pipeline.
+
+struct BenchConfig
+{
+  int sample_num;
+  int repeat;
+  int knn;
+  unsigned int seed;
+  bool compare_acceleration;
+  std::string label;
+};
+
+struct Measurement
+{
+  Measurement() : items(0), calls(0), iterations(-1), median(0), best(0) {}
+  std::string kernel;
+  size_t items;     // points one call works on
+  size_t calls;
+  int iterations;
+  double median;    // seconds of one run
+  double best;
+};
+
+static double
+seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// median and minimum of the run times
+static void
+summarize(std::vector<double> times, Measurement& m)
+{
+  std::sort(times.begin(), times.end());
+  size_t n = times.size();
+  m.median = n % 2 ? times[n / 2] : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+  m.best = times.front();
+}
+
+// run f config.repeat times after one warm-up run
+template <typename F>
+static Measurement
+timeKernel(const std::string& kernel, size_t items, const BenchConfig& config, F f)
+{
+  Measurement m;
+  m.kernel = kernel;
+  m.items = items;
+  m.calls = 1;
+  f();
+  std::vector<double> times;
+  for (int r = 0; r < config.repeat; r++) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    times.push_back(seconds(start));
+  }
+  summarize(times, m);
+  return m;
+}
+
+// config.repeat runs of the whole pipeline with paras, every one from the
+// same samples and random numbers; after_run(context) is called after every
+// run
+template <typename F>
+static Measurement
+timePipeline(const std::string& kernel, SkeletonContext& context, const ParameterMgr& paras,
+             const std::string& model, size_t points, const BenchConfig& config, F after_run)
+{
+  Measurement m;
+  m.kernel = kernel;
+  m.items = points;
+  m.calls = 1;
+  std::vector<double> times;
+  for (int r = 0; r < config.repeat; r++) {
+    context.clear();
+    context.resetParameters(paras);
+    context.loadOriginal(model);
+    Random::restart(Random::key(model));
+    context.sample(Sampler::VOXEL, config.sample_num, 0);
+    Profiler::clear();
+    auto start = std::chrono::steady_clock::now();
+    context.run();
+    times.push_back(seconds(start));
+    m.iterations = context.getAlgorithm()->getIterateNum();
+    after_run(context);
+  }
+  summarize(times, m);
+  return m;
+}
+
+// peak resident set size in MB since the last resetPeakMemory (Linux)
+static void
+resetPeakMemory()
+{
+  FILE* f = fopen("/proc/self/clear_refs", "w");
+  if (f != NULL) {
+    fputs("5", f);
+    fclose(f);
+  }
+}
+
+static double
+peakMemoryMB()
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return atof(line.c_str() + 6) / 1024.0;
+    }
+  }
+  return -1;
+}
+
+static std::string
+quote(const std::string& s)
+{
+  std::string q = "\"";
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] == '"' || s[i] == '\\') {
+      q += '\\';
+    }
+    q += s[i];
+  }
+  return q + "\"";
+}
+
+static void
+writeRecord(std::ostream& out, const BenchConfig& config, const std::string& model,
+            size_t points, size_t samples, double peak_mb, const Measurement& m)
+{
+  double throughput = m.median > 0 ? m.items * m.calls / m.median : 0;
+  out << std::setprecision(9)
+      << "{\"label\": " << quote(config.label)
+      << ", \"model\": " << quote(model)
+      << ", \"kernel\": " << quote(m.kernel)
+      << ", \"points\": " << points
+      << ", \"samples\": " << samples
+      << ", \"threads\": " << omp_get_max_threads()
+      << ", \"repeat\": " << config.repeat
+      << ", \"calls\": " << m.calls
+      << ", \"iterations\": " << m.iterations
+      << ", \"seconds\": " << m.median
+      << ", \"best_seconds\": " << m.best
+      << ", \"points_per_second\": " << throughput
+      << ", \"peak_rss_mb\": " << peak_mb << "}" << std::endl;
+}
+
+// total seconds and calls of every profiler section whose path ends in name
+static void
+sectionTotal(const std::vector<Profiler::Stat>& stats, const std::string& name,
+             double& total, size_t& calls)
+{
+  total = 0;
+  calls = 0;
+  for (size_t i = 0; i < stats.size(); i++) {
+    const std::string& path = stats[i].path;
+    if (path == name || (path.size() > name.size() &&
+                         path.compare(path.size() - name.size() - 1, std::string::npos,
+                                      "/" + name) == 0)) {
+      total += stats[i].total;
+      calls += stats[i].count;
+    }
+  }
+}
+
+static void
+benchModel(const std::string& model, const BenchConfig& config,
+           const ParameterMgr& base, std::ostream& out)
+{
+  SkeletonContext context(base);
+  resetPeakMemory();
+
+  std::vector<Measurement> results;
+  size_t points = 0, samples = 0;
+  double radius = 0;
+
+  // load and sample, also the data for the kernels below
+  Measurement load = timeKernel("load", 0, config, [&]() {
+    context.clear();
+    context.loadOriginal(model);
+  });
+  points = context.getData()->getCurrentOriginal()->vn;
+  if (points == 0) {
+    LOG_ERROR << "No points loaded from " << model;
+    return;
+  }
+  load.items = points;
+  results.push_back(load);
+
+  results.push_back(timeKernel("sample", points, config, [&]() {
+    context.resetParameters(base);
+    context.sample(Sampler::VOXEL, config.sample_num, 0);
+  }));
+  CMesh* original = context.getData()->getCurrentOriginal();
+  CMesh* sample_mesh = context.getData()->getCurrentSamples();
+  samples = sample_mesh->vn;
+  RichParameterSet* para = context.getSkeletonParameterSet();
+  radius = para->getDouble("CGrid Radius");
+  double h_gaussian = para->getDouble("H Gaussian Para");
+
+  results.push_back(timeKernel("cgrid_build", points, config, [&]() {
+    CGrid grid;
+    grid.init(original->vert, original->bbox, radius);
+  }));
+  results.push_back(timeKernel("ball_neighbors", samples, config, [&]() {
+    GlobalFun::computeBallNeighbors(sample_mesh, NULL, radius, sample_mesh->bbox);
+  }));
+  results.push_back(timeKernel("ball_neighbors_original", samples, config, [&]() {
+    Box3f box = sample_mesh->bbox;
+    box.Add(original->bbox);
+    GlobalFun::computeBallNeighbors(sample_mesh, original, radius, box);
+  }));
+  results.push_back(timeKernel("ann_knn", samples, config, [&]() {
+    GlobalFun::computeAnnNeigbhors(sample_mesh->vert, sample_mesh->vert, config.knn, false,
+                                   "skeleton_bench");
+  }));
+  GlobalFun::computeBallNeighbors(sample_mesh, NULL, radius, sample_mesh->bbox);
+  results.push_back(timeKernel("eigen_pca", samples, config, [&]() {
+    GlobalFun::computeEigenWithTheta(sample_mesh, radius / sqrt(h_gaussian));
+  }));
+
+  // the whole pipeline; the private kernels come from the profiler
+  const char* sections[3] = { "wlopIterate", "searchNewBranches()", "mergeNearEndsGroup()" };
+  const char* kernels[3] = { "wlop_iterate", "branch_search", "branch_merge" };
+  std::vector<double> section_times[3];
+  size_t section_calls[3] = { 0, 0, 0 };
+  Measurement pipeline = timePipeline("pipeline", context, base, model, points, config,
+                                      [&](SkeletonContext&) {
+    std::vector<Profiler::Stat> stats = Profiler::summary();
+    for (int k = 0; k < 3; k++) {
+      double total;
+      sectionTotal(stats, sections[k], total, section_calls[k]);
+      section_times[k].push_back(total);
+    }
+  });
+  results.push_back(pipeline);
+  for (int k = 0; k < 3; k++) {
+    Measurement m;
+    m.kernel = kernels[k];
+    m.items = samples;
+    m.calls = section_calls[k];
+    m.iterations = pipeline.iterations;
+    summarize(section_times[k], m);
+    results.push_back(m);
+  }
+
+  // the accelerated WLOP iterations against the plain pipeline above, only
+  // "Acceleration Mode" differs; compare their iterations and seconds
+  std::ostringstream accelerated;
+  if (config.compare_acceleration) {
+    const char* modes[2] = { "momentum", "anderson" };
+    for (int mode = 1; mode <= 2; mode++) {
+      ParameterMgr paras(base);
+      paras.getSkeletonParameterSet()->setValue("Acceleration Mode", IntValue(mode));
+      Measurement m = timePipeline(std::string("pipeline_") + modes[mode - 1], context, paras,
+                                   model, points, config, [](SkeletonContext&) {});
+      results.push_back(m);
+      accelerated << ", " << modes[mode - 1] << " " << m.iterations << " iterations, "
+                  << m.median << " s";
+    }
+  }
+
+  double peak_mb = peakMemoryMB();
+  std::string name = fs::path(model).filename().string();
+  for (size_t i = 0; i < results.size(); i++) {
+    writeRecord(out, config, name, points, samples, peak_mb, results[i]);
+  }
+  Log::flush();
+  std::cerr << name << ": " << points << " points, " << samples << " samples, "
+            << pipeline.iterations << " iterations, " << pipeline.median << " s"
+            << accelerated.str() << ", " << peak_mb << " MB peak" << std::endl;
+}
+
+int
+main(int argc, char** argv)
+{
+  BenchConfig config;
+  std::string models_dir;
+  std::string output;
+  std::string log_level;
+
+  po::variables_map vm;
+  po::options_description opts;
+  opts.add_options()
+    ("help,h", "Ask for help")
+    ("models-dir",
+     po::value<std::string>(&models_dir)->default_value(SKELETON_MODELS_DIR),
+     "Directory of the Figure*.ply models used without explicit models")
+    ("output,o",
+     po::value<std::string>(&output)->default_value("skeleton_bench.jsonl"),
+     "File the JSON lines are appended to")
+    ("label",
+     po::value<std::string>(&config.label)->default_value(""),
+     "Label stored with every record, e.g. the version benchmarked")
+    ("down-sample-num,n",
+     po::value<int>(&config.sample_num)->default_value(2000),
+     "Number of samples taken from every model")
+    ("repeat",
+     po::value<int>(&config.repeat)->default_value(3),
+     "Timed runs of every kernel, the median is reported")
+    ("knn",
+     po::value<int>(&config.knn)->default_value(10),
+     "Neighbors of the ANN KNN kernel")
+    ("seed",
+     po::value<unsigned int>(&config.seed)->default_value(1),
+     "Seed of the random numbers, every model restarts its stream")
+    ("compare-acceleration",
+     "Also run the pipeline with momentum and Anderson acceleration "
+     "(pipeline_momentum, pipeline_anderson) to compare their iterations "
+     "with the plain one")
+    ("log-level",
+     po::value<std::string>(&log_level)->default_value("warn"),
+     "Messages of the pipeline shown: error, warn, info, debug or trace")
+    ("model", po::value<std::vector<std::string> >(),
+     "Models to benchmark instead of the bundled ones")
+    ;
+
+  po::positional_options_description pos;
+  pos.add("model", -1);
+
+  po::store(po::command_line_parser(argc, argv)
+            .options(opts).positional(pos).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    std::cout << opts << std::endl;
+    exit(0);
+  }
+  int level = Log::levelFromName(log_level);
+  if (level < 0) {
+    std::cerr << "Unknown log level: " << log_level << std::endl;
+    exit(1);
+  }
+  Log::setLevel(level);
+  config.compare_acceleration = vm.count("compare-acceleration") > 0;
+  if (config.repeat < 1) {
+    config.repeat = 1;
+  }
+
+  std::vector<std::string> models;
+  if (vm.count("model")) {
+    models = vm["model"].as<std::vector<std::string> >();
+  } else {
+    glob_t matches;
+    std::string pattern = models_dir + "/Figure*.ply";
+    if (glob(pattern.c_str(), 0, NULL, &matches) == 0) {
+      for (size_t i = 0; i < matches.gl_pathc; i++) {
+        models.push_back(matches.gl_pathv[i]);
+      }
+    }
+    globfree(&matches);
+  }
+  if (models.empty()) {
+    std::cerr << "No models found in " << models_dir << std::endl;
+    exit(1);
+  }
+
+  std::ofstream out(output.c_str(), std::ios::app);
+  if (!out.is_open()) {
+    std::cerr << "Could not open " << output << std::endl;
+    exit(1);
+  }
+
+  // the parameters of pcd_skeleton's defaults, the same for every model
+  RichParameterSet* skelpara = global_paraMgr.getSkeletonParameterSet();
+  skelpara->setValue("Run Auto Wlop One Step", BoolValue(true));
+  ParameterMgr base(global_paraMgr);
+
+  Profiler::setEnabled(true);
+  Random::setSeed(config.seed);
+  for (size_t i = 0; i < models.size(); i++) {
+    benchModel(models[i], config, base, out);
+  }
+  std::cerr << "Results appended to " << output << std::endl;
+  return 0;
+}
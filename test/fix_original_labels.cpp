@@ -0,0 +1,74 @@
+#include "SkeletonContext.h"
+#include "Random.h"
+#include "Sampler.h"
+
+#include <iostream>
+#include <vector>
+
+// Skeletonizes a model with "Fuse Fix Original" on and off for every fix
+// mode, 1 to 5 (4 is the default), and checks that both give the same fixed
+// originals and the same skeleton. "Local Density Radius" keeps its default
+// of 0, which mode 2 resolves to 0.8 * "CGrid Radius" on both paths.
+
+struct Result
+{
+  std::vector<bool> fixed_original;
+  std::vector<Point3f> nodes;
+};
+
+static bool
+skeletonize(const std::string& model, int mode, bool fused, Result& result)
+{
+  SkeletonContext context;
+  RichParameterSet* para = context.getSkeletonParameterSet();
+  para->setValue("Run Auto Wlop One Step", BoolValue(true));
+  para->setValue("Fix Original Mode", IntValue(mode));
+  para->setValue("Fuse Fix Original", BoolValue(fused));
+  if (!context.loadOriginal(model)) {
+    return false;
+  }
+  Random::restart(1);
+  context.sample(Sampler::ORDERED, 0, 0);
+  context.run();
+
+  CMesh* original = context.getData()->getCurrentOriginal();
+  for (size_t i = 0; i < original->vert.size(); i++) {
+    result.fixed_original.push_back(original->vert[i].is_fixed_original);
+  }
+  Skeleton* skeleton = context.getSkeleton();
+  for (size_t b = 0; b < skeleton->branches.size(); b++) {
+    Curve& curve = skeleton->branches[b].curve;
+    for (size_t j = 0; j < curve.size(); j++) {
+      result.nodes.push_back(curve[j].P());
+    }
+  }
+  return true;
+}
+
+int
+main(int argc, char** argv)
+{
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <model>" << std::endl;
+    return 2;
+  }
+  Random::setSeed(1);
+
+  int failed = 0;
+  for (int mode = 1; mode <= 5; mode++) {
+    Result fused, unfused;
+    if (!skeletonize(argv[1], mode, true, fused) ||
+        !skeletonize(argv[1], mode, false, unfused)) {
+      std::cerr << "No points loaded from " << argv[1] << std::endl;
+      return 2;
+    }
+    if (fused.fixed_original != unfused.fixed_original) {
+      std::cerr << "Fix Original Mode " << mode << ": the fused labels differ" << std::endl;
+      failed++;
+    } else if (fused.nodes != unfused.nodes) {
+      std::cerr << "Fix Original Mode " << mode << ": the fused skeleton differs" << std::endl;
+      failed++;
+    }
+  }
+  return failed > 0 ? 1 : 0;
+}
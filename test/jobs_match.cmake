@@ -0,0 +1,42 @@
+# Skeletonizes two inputs with --jobs 1 and again with --jobs 2 and checks
+# that the skeletons are the same. Every file gets one OpenMP thread in both
+# runs, so only running the files at the same time differs.
+#
+#   cmake -DPCD_SKELETON=<pcd_skeleton> -DMODELS=<dir> -DWORK=<dir> -P jobs_match.cmake
+
+set(inputs Figure4_2D_S Figure6_2D_Leaf)
+
+file(REMOVE_RECURSE ${WORK})
+file(MAKE_DIRECTORY ${WORK})
+set(files)
+foreach(name ${inputs})
+  configure_file(${MODELS}/${name}.ply ${WORK}/${name}.ply COPYONLY)
+  list(APPEND files ${WORK}/${name}.ply)
+endforeach()
+
+function(skeletonize jobs)
+  set(ENV{OMP_NUM_THREADS} ${jobs})
+  execute_process(
+    COMMAND ${PCD_SKELETON} --seed 1 --down-sample-num 500 --log-level warn
+            --jobs ${jobs} ${files}
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "pcd_skeleton --jobs ${jobs} failed: ${result}")
+  endif()
+endfunction()
+
+skeletonize(1)
+foreach(name ${inputs})
+  file(RENAME ${WORK}/${name}.skel.pcd ${WORK}/${name}.jobs1.skel.pcd)
+endforeach()
+
+skeletonize(2)
+foreach(name ${inputs})
+  execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files
+            ${WORK}/${name}.jobs1.skel.pcd ${WORK}/${name}.skel.pcd
+    RESULT_VARIABLE different)
+  if(different)
+    message(FATAL_ERROR "${name}: the skeleton of --jobs 2 differs from --jobs 1")
+  endif()
+endforeach()